@@ -0,0 +1,172 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Shared helpers for the benchmarks: timer, stats and the seeded test boards.
+// Everything is static, each bench program includes this once.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "simulation.h"
+
+#define BENCH_DEFAULT_ITERATIONS 200
+#define BENCH_SEED 0x5A4D5EEDu
+
+typedef enum {
+        BOARD_EMPTY = 0,
+        BOARD_HALF_FULL,
+        BOARD_NEAR_GAME_OVER,
+        BOARD_CHECKERBOARD,
+        BOARD_FALLING,
+
+        BOARD_COUNT,
+} BenchBoard;
+
+static const char* BENCH_BOARD_NAMES[BOARD_COUNT] = {
+        "empty",
+        "half-full",
+        "near-game-over",
+        "checkerboard",
+        "falling",
+};
+
+typedef struct {
+        uint64_t* samples; // ns per call
+        int count;
+        int capacity;
+} BenchStats;
+
+static inline uint64_t bench_now_ns(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Small xorshift so boards don't depend on libc rand() or on the simulation's own random state
+static inline uint32_t bench_rand(uint32_t* state) {
+        uint32_t x = *state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return *state = x;
+}
+
+// Settled looking sand: colors come in small clumps so clearance has real regions to walk,
+// with a few holes so the sand step has something to move
+static void bench_fillSand(GameData* GD, int fromRow, int toRow, uint32_t* state) {
+        uint32_t salt = bench_rand(state);
+        for (int y = fromRow; y < toRow; y++) {
+                uint8_t* row = sim_row(GD, y);
+                for (int x = 0; x < GD->config.width; x++) {
+                        uint32_t clump = (((y / 6) * 131 + (x / 6) * 71) ^ salt) * 2654435761u >> 16;
+                        row[x] = clump % COLOR_COUNT;
+                        if (bench_rand(state) % 100 < 5) {
+                                row[x] = COLOR_NONE;
+                        }
+                }
+        }
+}
+
+static void bench_seedBoard(GameData* GD, BenchBoard board, uint32_t seed) {
+        uint32_t state = seed? seed: 1;
+        int width = GD->config.width;
+        int height = GD->config.height;
+
+        memset(GD->colorGrid, COLOR_NONE, (size_t) width * height);
+
+        switch (board) {
+                case BOARD_EMPTY: {
+                        break;
+                }
+
+                case BOARD_HALF_FULL: {
+                        bench_fillSand(GD, height / 2, height, &state);
+                        break;
+                }
+
+                case BOARD_NEAR_GAME_OVER: {
+                        bench_fillSand(GD, 3, height, &state);
+                        break;
+                }
+
+                case BOARD_CHECKERBOARD: {
+                        // Every neighbour has a different color: worst case for region detection
+                        for (int y = 2; y < height; y++) {
+                                for (int x = 0; x < width; x++) {
+                                        sim_row(GD, y)[x] = (x & 1) | ((y & 1) << 1);
+                                }
+                        }
+                        break;
+                }
+
+                case BOARD_FALLING: {
+                        // Right after a big clear: a slab of sand hanging over an empty bottom
+                        bench_fillSand(GD, height / 4, height * 3 / 4, &state);
+                        break;
+                }
+
+                default: break;
+        }
+}
+
+static void bench_statsInit(BenchStats* stats, int capacity) {
+        stats->samples = malloc(sizeof(uint64_t) * capacity);
+        stats->count = 0;
+        stats->capacity = capacity;
+}
+
+static inline void bench_statsAdd(BenchStats* stats, uint64_t ns) {
+        if (stats->count < stats->capacity) {
+                stats->samples[stats->count++] = ns;
+        }
+}
+
+static int bench_compareU64(const void* a, const void* b) {
+        uint64_t x = *(const uint64_t*) a;
+        uint64_t y = *(const uint64_t*) b;
+        return (x > y) - (x < y);
+}
+
+static uint64_t bench_percentile(const BenchStats* stats, double p) {
+        if (stats->count == 0) return 0;
+        int index = (int) (p / 100.0 * (stats->count - 1) + 0.5);
+        return stats->samples[index];
+}
+
+// Prints one result line, cellsPerCall = how many grid cells one call touches (0 to skip cells/sec)
+static void bench_report(BenchStats* stats, const char* what, const char* board, double cellsPerCall) {
+        qsort(stats->samples, stats->count, sizeof(uint64_t), bench_compareU64);
+
+        double total = 0;
+        for (int i = 0; i < stats->count; i++) {
+                total += stats->samples[i];
+        }
+        double mean = stats->count? total / stats->count: 0;
+
+        printf("%-40s %-15s %11.0f ns/frame  p50 %10llu  p90 %10llu  p99 %10llu",
+                what, board, mean,
+                (unsigned long long) bench_percentile(stats, 50),
+                (unsigned long long) bench_percentile(stats, 90),
+                (unsigned long long) bench_percentile(stats, 99));
+        if (cellsPerCall > 0 && mean > 0) {
+                printf("  %8.1f Mcells/s", cellsPerCall / mean * 1e3);
+        }
+        printf("\n");
+        fflush(stdout);
+
+        stats->count = 0;
+}
+
+static void bench_statsDestroy(BenchStats* stats) {
+        free(stats->samples);
+        stats->samples = NULL;
+}
+
+static int bench_iterations(int argc, char** argv) {
+        int iterations = (argc > 1)? atoi(argv[1]): BENCH_DEFAULT_ITERATIONS;
+        return iterations > 0? iterations: BENCH_DEFAULT_ITERATIONS;
+}
+
+#endif
@@ -0,0 +1,150 @@
+// Render hot paths. Needs SDL but no real display: uses the dummy video driver and
+// the software renderer, so numbers are CPU side only (no GPU upload / present).
+// Usage: cd build && ./bench_render [iterations]   (fonts are loaded from ./assets)
+
+#define _POSIX_C_SOURCE 199309L
+#include "bench.h"
+#include "game.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#define GRID_CELLS ((double) GAME_WIDTH * GAME_HEIGHT)
+
+int main(int argc, char** argv) {
+        int iterations = bench_iterations(argc, argv);
+
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+        if (SDL_Init(SDL_INIT_VIDEO) != 0 || TTF_Init() == -1) {
+                fprintf(stderr, "SDL_Init error: %s\n", SDL_GetError());
+                return 1;
+        }
+
+        // Only the parts of the context the render functions touch
+        GameContext* GC = calloc(1, sizeof(GameContext));
+        if (GC == NULL || !sim_init(&GC->gameData, sim_defaultConfig(), BENCH_SEED) || !frames_init(&GC->frames, &GC->gameData, 0)
+                || fontData_init(&GC->fontData) == -1) {
+                fprintf(stderr, "Initialization Error!\n");
+                return 1;
+        }
+
+        rng_seed(&GC->renderRng, BENCH_SEED);
+        GC->window = SDL_CreateWindow("bench", 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_HIDDEN);
+        GC->renderer = GC->window? SDL_CreateRenderer(GC->window, -1, SDL_RENDERER_SOFTWARE): NULL;
+        GC->texture = GC->renderer? SDL_CreateTexture(GC->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, GAME_WIDTH, GAME_HEIGHT): NULL;
+        if (!GC->texture) {
+                fprintf(stderr, "Renderer error: %s\n", SDL_GetError());
+                return 1;
+        }
+        GC->pixelFormat = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA8888);
+        buildPalette(GC);
+        SDL_RenderSetLogicalSize(GC->renderer, VIRTUAL_WIDTH, VIRTUAL_HEIGHT);
+
+        BenchStats stats;
+        bench_statsInit(&stats, iterations);
+
+        // What the sim thread does after its ticks, untimed: the game draws from frames
+        #define PUBLISH() do { \
+                frames_publish(&GC->frames, &GC->gameData, &GC->gameData.currentTetromino, 0); \
+                GC->frame = frames_take(&GC->frames, &GC->frameIsNew); \
+        } while (0)
+
+        printf("Grid %dx%d, %d iterations per case\n", GAME_WIDTH, GAME_HEIGHT, iterations);
+        for (BenchBoard b = 0; b < BOARD_COUNT; b++) {
+                bench_seedBoard(&GC->gameData, b, BENCH_SEED + b);
+
+                // Whole texture rewritten every call
+                for (int i = 0; i < iterations; i++) {
+                        sim_syncGrid(&GC->gameData);
+                        PUBLISH();
+                        uint64_t start = bench_now_ns();
+                        renderAllParticles(GC);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "renderAllParticles", BENCH_BOARD_NAMES[b], GRID_CELLS);
+
+                // Only the rows one sand step touched
+                for (int i = 0; i < iterations; i++) {
+                        sim_stepSand(&GC->gameData);
+                        PUBLISH();
+                        uint64_t start = bench_now_ns();
+                        renderAllParticles(GC);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "renderAllParticles (sand step)", BENCH_BOARD_NAMES[b], GRID_CELLS);
+
+                // Nothing changed since the last frame: no upload at all
+                for (int i = 0; i < iterations; i++) {
+                        uint64_t start = bench_now_ns();
+                        renderAllParticles(GC);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "renderAllParticles (unchanged)", BENCH_BOARD_NAMES[b], GRID_CELLS);
+        }
+
+        // Whole frame, side panel from the cached layer
+        for (int i = 0; i < iterations; i++) {
+                uint64_t start = bench_now_ns();
+                game_render(GC);
+                bench_statsAdd(&stats, bench_now_ns() - start);
+        }
+        bench_report(&stats, "game_render", "ui layer cached", 0);
+        unsigned cachedCalls = GC->drawCalls;
+
+        // Side panel drawn again every frame, what a changing score or slider costs
+        for (int i = 0; i < iterations; i++) {
+                GC->uiLayerValid = false;
+                uint64_t start = bench_now_ns();
+                game_render(GC);
+                bench_statsAdd(&stats, bench_now_ns() - start);
+        }
+        bench_report(&stats, "game_render", "ui layer redrawn", 0);
+        printf("game_render draw calls: %u ui layer cached, %u redrawn\n", cachedCalls, GC->drawCalls);
+
+        SDL_Color color = { 217, 219, 206, 255 };
+        SDL_Rect container = { INFO_PANEL_X, INFO_PANEL_Y, INFO_PANEL_WIDTH, 20 * SCALE_FACTOR };
+        char str[256];
+
+        // Same label every frame: cache hit
+        for (int i = 0; i < iterations; i++) {
+                uint64_t start = bench_now_ns();
+                font_render_rect(&GC->fontData, GC->renderer, "High Scores:", FONT_PATH, -1, TTF_STYLE_NORMAL, color, container);
+                bench_statsAdd(&stats, bench_now_ns() - start);
+        }
+        bench_report(&stats, "font_render_rect", "same text", 0);
+
+        // Score going up every frame: new text every call
+        for (int i = 0; i < iterations; i++) {
+                snprintf(str, sizeof(str), "Score: %15d", i);
+                uint64_t start = bench_now_ns();
+                font_render_rect(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, color, container);
+                bench_statsAdd(&stats, bench_now_ns() - start);
+        }
+        bench_report(&stats, "font_render_rect", "changing text", 0);
+
+        // Same, glyphs from the atlas
+        for (int i = 0; i < iterations; i++) {
+                snprintf(str, sizeof(str), "Score: %15d", i);
+                uint64_t start = bench_now_ns();
+                font_render_rect_atlas(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, color, container);
+                bench_statsAdd(&stats, bench_now_ns() - start);
+        }
+        bench_report(&stats, "font_render_rect_atlas", "changing text", 0);
+        printf("font cache: %d texts, %zu bytes, %u hits, %u misses, %u evictions\n",
+                GC->fontData.ct_count, GC->fontData.ct_bytes, GC->fontData.ct_hits, GC->fontData.ct_misses, GC->fontData.ct_evictions);
+
+        bench_statsDestroy(&stats);
+        fontData_destroy(&GC->fontData);
+        frames_free(&GC->frames);
+        sim_cleanup(&GC->gameData);
+        SDL_FreeFormat(GC->pixelFormat);
+        if (GC->uiLayer) {
+                SDL_DestroyTexture(GC->uiLayer);
+        }
+        SDL_DestroyTexture(GC->texture);
+        SDL_DestroyRenderer(GC->renderer);
+        SDL_DestroyWindow(GC->window);
+        TTF_Quit();
+        SDL_Quit();
+        free(GC);
+        return 0;
+}
@@ -0,0 +1,209 @@
+// Simulation hot paths, no SDL needed.
+// Usage: ./build/bench_sim [iterations] [WxH]   (grid size, default is the game's)
+
+#define _POSIX_C_SOURCE 199309L
+#include "bench.h"
+#include "simulation.h"
+#include "snapshot.h"
+#include "frames.h"
+
+int main(int argc, char** argv) {
+        int iterations = bench_iterations(argc, argv);
+        SimConfig config = sim_defaultConfig();
+        if (argc > 2 && !sim_parseConfig(argv[2], &config)) {
+                fprintf(stderr, "Usage: %s [iterations] [WxH]\n", argv[0]);
+                return 1;
+        }
+
+        GameData* GD = malloc(sizeof(GameData));
+        if (GD == NULL || !sim_init(GD, config, BENCH_SEED)) {
+                fprintf(stderr, "Simulation Initialization Error!\n");
+                return 1;
+        }
+        size_t gridBytes = (size_t) config.width * config.height;
+        double cells = (double) gridBytes;
+        uint8_t* board = malloc(gridBytes); // pristine copy, restored before every timed call
+        uint8_t* snapshot = malloc(snapshot_maxSize(GD));
+        SimFrames frames;
+        if (board == NULL || snapshot == NULL || !frames_init(&frames, GD, 0)) {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+        }
+
+        BenchStats stats;
+        bench_statsInit(&stats, iterations);
+
+        printf("Grid %dx%d (%s kernels), %d iterations per case, sand on %d threads\n", config.width, config.height,
+                GD->kernels? "sized": "any size", iterations, workpool_threads(GD->pool));
+        for (BenchBoard b = 0; b < BOARD_COUNT; b++) {
+                bench_seedBoard(GD, b, BENCH_SEED + b);
+                memcpy(board, GD->colorGrid, gridBytes);
+
+                for (int i = 0; i < iterations; i++) {
+                        memcpy(GD->colorGrid, board, gridBytes);
+                        sim_syncGrid(GD);
+                        uint64_t start = bench_now_ns();
+                        sim_stepSand(GD);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "update_sand_particle_falling", BENCH_BOARD_NAMES[b], cells);
+
+                // Same stripes without the pool, for comparison with the threaded default
+                sim_setStepper(GD, SIM_STEPPER_SERIAL, 1);
+                for (int i = 0; i < iterations; i++) {
+                        memcpy(GD->colorGrid, board, gridBytes);
+                        sim_syncGrid(GD);
+                        uint64_t start = bench_now_ns();
+                        sim_stepSand(GD);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "update_sand_particle_falling (serial)", BENCH_BOARD_NAMES[b], cells);
+                sim_setStepper(GD, SIM_STEPPER_STRIPES, 0);
+
+                // Same step without the SSE2 fall kernel
+                bool simdFall = GD->simdFall;
+                GD->simdFall = false;
+                for (int i = 0; i < iterations; i++) {
+                        memcpy(GD->colorGrid, board, gridBytes);
+                        sim_syncGrid(GD);
+                        uint64_t start = bench_now_ns();
+                        sim_stepSand(GD);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "update_sand_particle_falling (scalar)", BENCH_BOARD_NAMES[b], cells);
+                GD->simdFall = simdFall;
+
+                // Same step through the any size loops, what a size without its own kernels gets
+                if (GD->kernels) {
+                        GD->sizedKernels = false;
+                        for (int i = 0; i < iterations; i++) {
+                                memcpy(GD->colorGrid, board, gridBytes);
+                                sim_syncGrid(GD);
+                                uint64_t start = bench_now_ns();
+                                sim_stepSand(GD);
+                                bench_statsAdd(&stats, bench_now_ns() - start);
+                        }
+                        bench_report(&stats, "update_sand_particle_falling (any size)", BENCH_BOARD_NAMES[b], cells);
+                        GD->sizedKernels = true;
+                }
+
+                // Same sand whatever runs it: serial against every stripe of a pass on its own thread
+                memcpy(GD->colorGrid, board, gridBytes);
+                sim_syncGrid(GD);
+                size_t saved = snapshot_write(GD, snapshot, snapshot_maxSize(GD));
+                uint64_t hashes[2];
+                for (int run = 0; run < 2; run++) {
+                        snapshot_read(GD, snapshot, saved);
+                        sim_setStepper(GD, run == 0? SIM_STEPPER_SERIAL: SIM_STEPPER_STRIPES, run == 0? 1: (GD->stripes + 1) / 2);
+                        for (int i = 0; i < 64; i++) {
+                                sim_stepSand(GD);
+                        }
+                        hashes[run] = sim_hashGrid(GD);
+                }
+                sim_setStepper(GD, SIM_STEPPER_STRIPES, 0);
+                if (hashes[0] != hashes[1]) {
+                        fprintf(stderr, "%s: serial and striped sand differ after 64 steps (%016llx, %016llx)\n",
+                                BENCH_BOARD_NAMES[b], (unsigned long long) hashes[0], (unsigned long long) hashes[1]);
+                        return 1;
+                }
+
+                // Let the pile come to rest so every chunk falls asleep, then time the idle step
+                for (int i = 0; i < 4 * config.height; i++) {
+                        sim_stepSand(GD);
+                }
+                for (int i = 0; i < iterations; i++) {
+                        uint64_t start = bench_now_ns();
+                        sim_stepSand(GD);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "update_sand_particle_falling (settled)", BENCH_BOARD_NAMES[b], cells);
+
+                for (int i = 0; i < iterations; i++) {
+                        memcpy(GD->colorGrid, board, gridBytes);
+                        sim_syncGrid(GD); // Every color counts as changed: full check
+                        uint64_t start = bench_now_ns();
+                        sim_detectClearance(GD);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "sandClearance", BENCH_BOARD_NAMES[b], cells);
+
+                // Nothing changed since the last check
+                for (int i = 0; i < iterations; i++) {
+                        uint64_t start = bench_now_ns();
+                        sim_detectClearance(GD);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "sandClearance (settled)", BENCH_BOARD_NAMES[b], cells);
+
+                // Piece just entered the field, worst case for the ghost drop
+                memcpy(GD->colorGrid, board, gridBytes);
+                sim_syncGrid(GD);
+                GD->currentTetromino.y = GAME_POS_Y;
+                for (int i = 0; i < iterations; i++) {
+                        uint64_t start = bench_now_ns();
+                        sim_updateGhost(GD);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "updateGhostTetromino", BENCH_BOARD_NAMES[b], 0);
+
+                size_t size = 0;
+                for (int i = 0; i < iterations; i++) {
+                        uint64_t start = bench_now_ns();
+                        size = snapshot_write(GD, snapshot, snapshot_maxSize(GD));
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "snapshot_write", BENCH_BOARD_NAMES[b], cells);
+
+                for (int i = 0; i < iterations; i++) {
+                        uint64_t start = bench_now_ns();
+                        snapshot_read(GD, snapshot, size);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "snapshot_read", BENCH_BOARD_NAMES[b], cells);
+                printf("snapshot: %zu bytes\n", size);
+
+                // Every grain marked at once, the biggest clear there can be
+                for (int i = 0; i < iterations; i++) {
+                        for (size_t cell = 0; cell < gridBytes; cell++) {
+                                GD->colorGrid[cell] = (board[cell] == COLOR_NONE)? COLOR_NONE: COLOR_DELETE_MARKED_SAND;
+                        }
+                        sim_syncGrid(GD);
+                        uint64_t start = bench_now_ns();
+                        sim_removeMarked(GD);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "removeMarkedSand (all marked)", BENCH_BOARD_NAMES[b], cells);
+
+                // Hand over to the renderer after a tick: every row changed, then one sand step's rows.
+                // Each buffer lags the sim by two publishes, so this copies what the last three changed
+                for (int i = 0; i < iterations; i++) {
+                        memcpy(GD->colorGrid, board, gridBytes);
+                        sim_syncGrid(GD);
+                        uint64_t start = bench_now_ns();
+                        frames_publish(&frames, GD, &GD->currentTetromino, 0);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "frames_publish", BENCH_BOARD_NAMES[b], cells);
+
+                memcpy(GD->colorGrid, board, gridBytes);
+                sim_syncGrid(GD);
+                for (int i = 0; i < SIM_FRAME_BUFFERS; i++) {
+                        frames_publish(&frames, GD, &GD->currentTetromino, 0); // Every buffer up to date
+                }
+                for (int i = 0; i < iterations; i++) {
+                        sim_stepSand(GD);
+                        uint64_t start = bench_now_ns();
+                        frames_publish(&frames, GD, &GD->currentTetromino, 0);
+                        bench_statsAdd(&stats, bench_now_ns() - start);
+                }
+                bench_report(&stats, "frames_publish (sand step)", BENCH_BOARD_NAMES[b], cells);
+        }
+
+        bench_statsDestroy(&stats);
+        frames_free(&frames);
+        sim_cleanup(GD);
+        free(snapshot);
+        free(board);
+        free(GD);
+        return 0;
+}
@@ -27,7 +27,7 @@ void updateSliderSFX(AudioSlider *slider, AudioData *audio, int mouseX, int mous
 
 
 // Render slider
-void renderSlider(SDL_Renderer *renderer, AudioSlider *slider) {
+void renderSlider(DrawBatch *batch, AudioSlider *slider) {
         // Draw slider track (background bar)
         SDL_Rect track = {
                 slider->x,
@@ -35,8 +35,7 @@ void renderSlider(SDL_Renderer *renderer, AudioSlider *slider) {
                 slider->w,
                 slider->h / 2
         };
-        SDL_SetRenderDrawColor(renderer, 60, 60, 60, 255);
-        SDL_RenderFillRect(renderer, &track);
+        drawbatch_fill(batch, track, (SDL_Color) { 60, 60, 60, 255 });
 
         // Draw filled portion (to show volume level)
         SDL_Rect filled = {
@@ -45,12 +44,10 @@ void renderSlider(SDL_Renderer *renderer, AudioSlider *slider) {
                 slider->handleX - slider->x + slider->handleW / 2,
                 slider->h / 2
         };
-        SDL_SetRenderDrawColor(renderer, 150, 50, 50, 255);
-        SDL_RenderFillRect(renderer, &filled);
+        drawbatch_fill(batch, filled, (SDL_Color) { 150, 50, 50, 255 });
 
         // Draw track border
-        SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
-        SDL_RenderDrawRect(renderer, &track);
+        drawbatch_outline(batch, track, (SDL_Color) { 100, 100, 100, 255 });
 
         // Draw handle (slider button)
         SDL_Rect handle = {
@@ -59,12 +56,10 @@ void renderSlider(SDL_Renderer *renderer, AudioSlider *slider) {
                 slider->handleW,
                 slider->h
         };
-        SDL_SetRenderDrawColor(renderer, 220, 80, 80, 255);
-        SDL_RenderFillRect(renderer, &handle);
+        drawbatch_fill(batch, handle, (SDL_Color) { 220, 80, 80, 255 });
 
         // Draw handle border
-        SDL_SetRenderDrawColor(renderer, 255, 100, 100, 255);
-        SDL_RenderDrawRect(renderer, &handle);
+        drawbatch_outline(batch, handle, (SDL_Color) { 255, 100, 100, 255 });
 }
 
 // Initialize audio system
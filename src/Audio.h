@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include "drawbatch.h"
 
 // Audio Specific
 #define BG_MUSIC "./assets/Audio/Music/Bg_music.mp3"
@@ -56,6 +57,6 @@ void audio_cleanup(AudioData* audio);
 
 void updateSliderMusic(AudioSlider *slider, AudioData *audio, int mouseX, int mouseY, int mouseState);
 void updateSliderSFX(AudioSlider *slider, AudioData *audio, int mouseX, int mouseY, int mouseState);
-void renderSlider(SDL_Renderer *renderer, AudioSlider *slider);
+void renderSlider(DrawBatch *batch, AudioSlider *slider); // Into the batch, drawn at its flush
 
 #endif
\ No newline at end of file
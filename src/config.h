@@ -7,6 +7,11 @@
 
 #define SAND_STEP_TIME (1.0f / 18.0f) / SCALE_FACTOR // Define how much update in sand per frame
 
+// The simulation always advances in whole ticks of this size, whatever the frame rate
+#define SIM_TICK_RATE 120
+#define SIM_TICK_SECONDS (1.0f / SIM_TICK_RATE)
+#define SIM_MAX_TICKS_PER_FRAME 8 // Catch-up budget after a stall, anything older is dropped (game slows down instead of freezing)
+
 #define VIRTUAL_WIDTH 240 * SCALE_FACTOR
 #define VIRTUAL_HEIGHT 230 * SCALE_FACTOR
 
@@ -31,11 +36,19 @@
 #define GRAVITY 9.8f
 #define TETRIMINO_MOVE_SPEED 150 * SCALE_FACTOR
 #define TIME_FOR_SAND_DELETION 0.25f
+#define CLEAR_HITSTOP_TIME 0.1f // Sand and gravity hold still this long after a clear
+#define CLEAR_FLASH_TIME 0.3f
 
 #define BASE_FONT_SIZE 124
+#define FONT_CACHE_MAX_TEXTS 64 // Rendered labels kept around, least recently used ones get dropped
+#define FONT_CACHE_MAX_BYTES (16 * 1024 * 1024)
 #define HIGH_SCORE_COUNT 5
 
 #define FONT_PATH "./assets/Fonts/Comfortaa.ttf"
 #define HIGH_SCORE_FILE "./__HIGH_SCORES__.txt"
+#define TRACE_ZONES 1 // Timing zones around the frame's parts, F12 writes the last few seconds to TRACE_FILE. See trace.h
+#define TRACE_RING_EVENTS 32768 // Zones kept per thread, a frame records about 20 on the main thread
+#define TRACE_FILE "./__TRACE__.json" // Open in chrome://tracing or ui.perfetto.dev
+#define REPLAY_FILE "./__LAST_SESSION__.replay" // Every session is recorded, written on exit. See tools/playback.c
 
 #endif
@@ -0,0 +1,78 @@
+#include "drawbatch.h"
+#include <string.h>
+#include "drawstats.h"
+
+void drawbatch_begin(DrawBatch* DB, SDL_Renderer* renderer) {
+        DB->renderer = renderer;
+        DB->count = 0;
+}
+
+void drawbatch_fill(DrawBatch* DB, SDL_Rect rect, SDL_Color color) {
+        if (rect.w <= 0 || rect.h <= 0) {
+                return;
+        }
+        if (DB->count == DRAW_BATCH_QUADS) {
+                drawbatch_flush(DB);
+        }
+        DB->rects[DB->count] = rect;
+        DB->colors[DB->count] = color;
+        DB->count++;
+}
+
+void drawbatch_outline(DrawBatch* DB, SDL_Rect rect, SDL_Color color) {
+        if (rect.w <= 2 || rect.h <= 2) {
+                drawbatch_fill(DB, rect, color); // All border, nothing inside
+                return;
+        }
+
+        // Full width top and bottom rows, the sides between them: no pixel blended twice
+        drawbatch_fill(DB, (SDL_Rect) { rect.x, rect.y, rect.w, 1 }, color);
+        drawbatch_fill(DB, (SDL_Rect) { rect.x, rect.y + rect.h - 1, rect.w, 1 }, color);
+        drawbatch_fill(DB, (SDL_Rect) { rect.x, rect.y + 1, 1, rect.h - 2 }, color);
+        drawbatch_fill(DB, (SDL_Rect) { rect.x + rect.w - 1, rect.y + 1, 1, rect.h - 2 }, color);
+}
+
+void drawbatch_flush(DrawBatch* DB) {
+        if (DB->count == 0) {
+                return;
+        }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        // Two triangles per rect, all in a single draw. Untextured, so it blends with the draw blend mode
+        SDL_Vertex vertices[DRAW_BATCH_QUADS * 4];
+        int indices[DRAW_BATCH_QUADS * 6];
+        for (int i = 0; i < DB->count; i++) {
+                const SDL_Rect* r = &DB->rects[i];
+                float x0 = r->x, x1 = r->x + r->w;
+                float y0 = r->y, y1 = r->y + r->h;
+                SDL_Color color = DB->colors[i];
+
+                SDL_Vertex* v = &vertices[i * 4];
+                v[0] = (SDL_Vertex) { { x0, y0 }, color, { 0, 0 } };
+                v[1] = (SDL_Vertex) { { x1, y0 }, color, { 0, 0 } };
+                v[2] = (SDL_Vertex) { { x1, y1 }, color, { 0, 0 } };
+                v[3] = (SDL_Vertex) { { x0, y1 }, color, { 0, 0 } };
+
+                int* idx = &indices[i * 6];
+                int base = i * 4;
+                idx[0] = base; idx[1] = base + 1; idx[2] = base + 2;
+                idx[3] = base; idx[4] = base + 2; idx[5] = base + 3;
+        }
+        SDL_RenderGeometry(DB->renderer, NULL, vertices, DB->count * 4, indices, DB->count * 6);
+        drawCallCount++;
+#else
+        // Older SDL: one call per run of the same color, merging across runs would change what's on top
+        for (int i = 0; i < DB->count;) {
+                SDL_Color color = DB->colors[i];
+                int end = i + 1;
+                while (end < DB->count && memcmp(&DB->colors[end], &color, sizeof(color)) == 0) {
+                        end++;
+                }
+                SDL_SetRenderDrawColor(DB->renderer, color.r, color.g, color.b, color.a);
+                SDL_RenderFillRects(DB->renderer, &DB->rects[i], end - i);
+                drawCallCount++;
+                i = end;
+        }
+#endif
+        DB->count = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef DRAWBATCH_H
+#define DRAWBATCH_H
+
+// Colored rectangles collected over a part of the frame and handed to the renderer at once,
+// instead of a color change and a fill or outline call per rectangle.
+//
+//         DrawBatch batch;
+//         drawbatch_begin(&batch, renderer);
+//         drawbatch_fill(&batch, rect, color);
+//         drawbatch_outline(&batch, rect, borderColor);
+//         drawbatch_flush(&batch);
+//
+// Drawn in the order they were added, under whatever clip rect and scale are set at the flush.
+// With SDL 2.0.18 and up that is one SDL_RenderGeometry call, before it one SDL_RenderFillRects
+// per run of the same color.
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#define DRAW_BATCH_QUADS 256 // A full batch flushes itself
+
+typedef struct {
+        SDL_Renderer* renderer;
+        SDL_Rect rects[DRAW_BATCH_QUADS];
+        SDL_Color colors[DRAW_BATCH_QUADS];
+        int count;
+} DrawBatch;
+
+void drawbatch_begin(DrawBatch*, SDL_Renderer*);
+void drawbatch_fill(DrawBatch*, SDL_Rect, SDL_Color);
+// Same pixels as SDL_RenderDrawRect, as up to four rects that don't overlap
+void drawbatch_outline(DrawBatch*, SDL_Rect, SDL_Color);
+// Draws what was added and empties the batch
+void drawbatch_flush(DrawBatch*);
+
+#endif
@@ -0,0 +1,3 @@
+#include "drawstats.h"
+
+unsigned drawCallCount = 0;
@@ -0,0 +1,8 @@
+#ifndef DRAWSTATS_H
+#define DRAWSTATS_H
+
+// Render calls that drew something since the last reset: batches, copies, clears, text.
+// game_render resets it at the start of every frame, see GameContext.drawCalls
+extern unsigned drawCallCount;
+
+#endif
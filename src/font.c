@@ -1,24 +1,60 @@
 #include "font.h"
 #include <SDL2/SDL_ttf.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "config.h"
+#include "drawstats.h"
 
 // Font related
 int fontData_init(FontData *FD) {
+        return fontData_init_budget(FD, FONT_CACHE_MAX_TEXTS, FONT_CACHE_MAX_BYTES);
+}
+
+int fontData_init_budget(FontData *FD, int maxTexts, size_t maxBytes) {
         FD->fe_count = 0;
         FD->fe_capacity = 4;
         FD->fontEntries = malloc(sizeof(FontEntry) * FD->fe_capacity);
 
-        FD->ct_count = 0;
-        FD->ct_capacity = 8;
-        FD->cachedTexts = malloc(sizeof(CachedText) * FD->ct_capacity);
+        if (maxTexts < 1) maxTexts = 1;
+        int buckets = 1;
+        while (buckets < maxTexts * 2) buckets <<= 1; // Load factor <= 0.5
 
-        if (!FD->fontEntries || !FD->cachedTexts) {
+        FD->ct_count = 0;
+        FD->ct_capacity = maxTexts;
+        FD->cachedTexts = malloc(sizeof(CachedText) * maxTexts);
+        FD->ct_buckets = malloc(sizeof(int) * buckets);
+        FD->ct_bucketMask = buckets - 1;
+        FD->ct_lruHead = FD->ct_lruTail = -1;
+        FD->ct_bytes = 0;
+        FD->ct_byteBudget = maxBytes;
+        FD->ct_hits = FD->ct_misses = FD->ct_evictions = 0;
+
+        FD->ga_count = 0;
+        FD->ga_capacity = 0;
+        FD->atlases = NULL;
+
+        if (!FD->fontEntries || !FD->cachedTexts || !FD->ct_buckets) {
+                free(FD->fontEntries);
+                free(FD->cachedTexts);
+                free(FD->ct_buckets);
+                FD->fontEntries = NULL;
+                FD->cachedTexts = NULL;
+                FD->ct_buckets = NULL;
                 return -1;
         }
 
+        for (int i = 0; i < buckets; i++) {
+                FD->ct_buckets[i] = -1;
+        }
+        for (int i = 0; i < maxTexts; i++) {
+                FD->cachedTexts[i].texture = NULL;
+                FD->cachedTexts[i].nextInBucket = (i + 1 < maxTexts) ? i + 1 : -1;
+        }
+        FD->ct_freeHead = 0;
+
         return 0;
 }
 
@@ -57,13 +93,92 @@ static TTF_Font* font_get(FontData *FD, const char *path, int size, uint8_t styl
         return font;
 }
 
-static void font_add_cache(FontData *data, SDL_Renderer *renderer, const char *text, const char *font_path, int fontSize, uint8_t style, SDL_Color color, SDL_Texture *texture, int w, int h) {
-        if (data->ct_count >= data->ct_capacity) {
-                data->ct_capacity *= 2;
-                data->cachedTexts = realloc(data->cachedTexts, sizeof(CachedText) * data->ct_capacity);
+static SDL_Texture* font_create_texture(FontData *data, SDL_Renderer *renderer, TTF_Font *font, const char *text, SDL_Color color, int *outW, int *outH) {
+        SDL_Surface *surface = TTF_RenderUTF8_Blended_Wrapped(font, text, color, 0);
+        if (!surface) return NULL;
+
+        SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+        if (!texture) {
+                SDL_FreeSurface(surface);
+                return NULL;
+        }
+
+        *outW = surface->w;
+        *outH = surface->h;
+        SDL_FreeSurface(surface);
+
+        return texture;
+}
+
+// FNV-1a over everything that makes a rendered text different
+static uint32_t font_hash(const char *text, const char *font_path, int fontSize, uint8_t style, SDL_Color color) {
+        uint32_t h = 2166136261u;
+        for (const char *c = text; *c; c++) h = (h ^ (uint8_t)*c) * 16777619u;
+        h = (h ^ 0xFF) * 16777619u; // Separator, "ab" + "c" != "a" + "bc"
+        for (const char *c = font_path; *c; c++) h = (h ^ (uint8_t)*c) * 16777619u;
+
+        uint32_t packed[3] = {
+                (uint32_t)fontSize,
+                style,
+                (uint32_t)color.r | (uint32_t)color.g << 8 | (uint32_t)color.b << 16 | (uint32_t)color.a << 24
+        };
+        for (int i = 0; i < 3; i++) h = (h ^ packed[i]) * 16777619u;
+        return h;
+}
+
+static void font_lru_unlink(FontData *data, int i) {
+        CachedText *cache = &data->cachedTexts[i];
+        if (cache->lruPrev != -1) data->cachedTexts[cache->lruPrev].lruNext = cache->lruNext;
+        else data->ct_lruHead = cache->lruNext;
+        if (cache->lruNext != -1) data->cachedTexts[cache->lruNext].lruPrev = cache->lruPrev;
+        else data->ct_lruTail = cache->lruPrev;
+}
+
+static void font_lru_push_front(FontData *data, int i) {
+        CachedText *cache = &data->cachedTexts[i];
+        cache->lruPrev = -1;
+        cache->lruNext = data->ct_lruHead;
+        if (data->ct_lruHead != -1) data->cachedTexts[data->ct_lruHead].lruPrev = i;
+        data->ct_lruHead = i;
+        if (data->ct_lruTail == -1) data->ct_lruTail = i;
+}
+
+static size_t font_texture_bytes(const CachedText *cache) {
+        return (size_t)cache->w * cache->h * 4;
+}
+
+// Drops the least recently used text and its texture
+static void font_evict(FontData *data) {
+        int i = data->ct_lruTail;
+        if (i == -1) return;
+        CachedText *cache = &data->cachedTexts[i];
+
+        // Unhook from its hash chain
+        int *link = &data->ct_buckets[cache->hash & data->ct_bucketMask];
+        while (*link != i) link = &data->cachedTexts[*link].nextInBucket;
+        *link = cache->nextInBucket;
+
+        font_lru_unlink(data, i);
+        SDL_DestroyTexture(cache->texture);
+        cache->texture = NULL;
+        data->ct_bytes -= font_texture_bytes(cache);
+        data->ct_count--;
+        data->ct_evictions++;
+
+        cache->nextInBucket = data->ct_freeHead;
+        data->ct_freeHead = i;
+}
+
+static void font_add_cache(FontData *data, uint32_t hash, const char *text, const char *font_path, int fontSize, uint8_t style, SDL_Color color, SDL_Texture *texture, int w, int h) {
+        // Make room, a single text bigger than the whole byte budget is still kept
+        size_t bytes = (size_t)w * h * 4;
+        while (data->ct_count > 0 && (data->ct_freeHead == -1 || data->ct_bytes + bytes > data->ct_byteBudget)) {
+                font_evict(data);
         }
 
-        CachedText *cache = &data->cachedTexts[data->ct_count];
+        int i = data->ct_freeHead;
+        CachedText *cache = &data->cachedTexts[i];
+        data->ct_freeHead = cache->nextInBucket;
 
         // Copy text (safe with bounds check)
         strncpy(cache->text, text, sizeof(cache->text) - 1);
@@ -76,31 +191,22 @@ static void font_add_cache(FontData *data, SDL_Renderer *renderer, const char *t
         cache->texture = texture;
         cache->w = w;
         cache->h = h;
+        cache->hash = hash;
 
-        data->ct_count++;
-}
-
-static SDL_Texture* font_create_texture(FontData *data, SDL_Renderer *renderer, TTF_Font *font, const char *text, SDL_Color color, int *outW, int *outH) {
-        SDL_Surface *surface = TTF_RenderUTF8_Blended_Wrapped(font, text, color, 0);
-        if (!surface) return NULL;
-
-        SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (!texture) {
-                SDL_FreeSurface(surface);
-                return NULL;
-        }
-
-        *outW = surface->w;
-        *outH = surface->h;
-        SDL_FreeSurface(surface);
+        int *bucket = &data->ct_buckets[hash & data->ct_bucketMask];
+        cache->nextInBucket = *bucket;
+        *bucket = i;
+        font_lru_push_front(data, i);
 
-        return texture;
+        data->ct_bytes += bytes;
+        data->ct_count++;
 }
 
-static CachedText* font_find_cache(FontData *data, const char *text, const char *font_path, int fontSize, uint8_t style, SDL_Color color) {
-        for (int i = 0; i < data->ct_count; i++) {
+static CachedText* font_find_cache(FontData *data, uint32_t hash, const char *text, const char *font_path, int fontSize, uint8_t style, SDL_Color color) {
+        for (int i = data->ct_buckets[hash & data->ct_bucketMask]; i != -1; i = data->cachedTexts[i].nextInBucket) {
                 CachedText *cache = &data->cachedTexts[i];
                 if (
+                        cache->hash == hash &&
                         cache->fontSize == fontSize &&
                         cache->style == style &&
                         cache->color.r == color.r &&
@@ -110,11 +216,36 @@ static CachedText* font_find_cache(FontData *data, const char *text, const char
                         strcmp(cache->fontPath, font_path) == 0 &&
                         strcmp(cache->text, text) == 0
                 ) {
+                        // Most recently used goes to the front
+                        font_lru_unlink(data, i);
+                        font_lru_push_front(data, i);
                         return cache;
                 }
         }
         return NULL;
 }
+
+// Scale to fit container (keep aspect ratio), centered
+static void font_draw_fit(SDL_Renderer *renderer, SDL_Texture *texture, int texW, int texH, SDL_Rect container) {
+        float scaleX = (float)container.w / texW;
+        float scaleY = (float)container.h / texH;
+        float scale = SDL_min(scaleX, scaleY);
+        scale = SDL_min(scale, 1.0f);
+
+        int drawW = (int)(texW * scale);
+        int drawH = (int)(texH * scale);
+
+        SDL_Rect dst = {
+                .x = container.x + (container.w - drawW) / 2,
+                .y = container.y + (container.h - drawH) / 2,
+                .w = drawW,
+                .h = drawH
+        };
+
+        SDL_RenderCopy(renderer, texture, NULL, &dst);
+        drawCallCount++;
+}
+
 void font_render_rect(
         FontData *data,
         SDL_Renderer *renderer,
@@ -131,32 +262,16 @@ void font_render_rect(
         int actualSize = (fontSize == -1) ? BASE_FONT_SIZE : fontSize;
 
         // 1. Check cache first
-        CachedText *cache = font_find_cache(data, text, font_path, actualSize, fontStyle, color);
+        uint32_t hash = font_hash(text, font_path, actualSize, fontStyle, color);
+        CachedText *cache = font_find_cache(data, hash, text, font_path, actualSize, fontStyle, color);
 
         if (cache) {
                 // Cache hit - use cached texture
-                int texW = cache->w;
-                int texH = cache->h;
-
-                // Scale to fit container (keep aspect ratio)
-                float scaleX = (float)container.w / texW;
-                float scaleY = (float)container.h / texH;
-                float scale = SDL_min(scaleX, scaleY);
-                scale = SDL_min(scale, 1.0f);
-
-                int drawW = (int)(texW * scale);
-                int drawH = (int)(texH * scale);
-
-                SDL_Rect dst = {
-                        .x = container.x + (container.w - drawW) / 2,
-                        .y = container.y + (container.h - drawH) / 2,
-                        .w = drawW,
-                        .h = drawH
-                };
-
-                SDL_RenderCopy(renderer, cache->texture, NULL, &dst);
+                data->ct_hits++;
+                font_draw_fit(renderer, cache->texture, cache->w, cache->h, container);
                 return;
         }
+        data->ct_misses++;
 
         // 2. Cache miss - create new texture
         TTF_Font *font = font_get(data, font_path, actualSize, fontStyle);
@@ -167,25 +282,244 @@ void font_render_rect(
         if (!texture) return;
 
         // 3. Add to cache
-        font_add_cache(data, renderer, text, font_path, actualSize, fontStyle, color, texture, texW, texH);
+        font_add_cache(data, hash, text, font_path, actualSize, fontStyle, color, texture, texW, texH);
 
         // 4. Render the texture
-        float scaleX = (float)container.w / texW;
-        float scaleY = (float)container.h / texH;
-        float scale = SDL_min(scaleX, scaleY);
-        scale = SDL_min(scale, 1.0f);
+        font_draw_fit(renderer, texture, texW, texH, container);
+}
 
-        int drawW = (int)(texW * scale);
-        int drawH = (int)(texH * scale);
+#define ATLAS_WIDTH 1024
+
+// Same pen walk as a rendered string: where each glyph of text starts, and the width of the line
+static int font_atlas_layout(const GlyphAtlas *atlas, const char *text, size_t length, int *penX) {
+        int pen = 0, textW = 0;
+        for (size_t i = 0; i < length; i++) {
+                int g = (uint8_t)text[i] - ATLAS_FIRST_GLYPH;
+                if (i > 0) pen += atlas->kerning[(uint8_t)text[i - 1] - ATLAS_FIRST_GLYPH][g];
+                penX[i] = pen + atlas->glyphs[g].xOffset;
+                textW = SDL_max(textW, penX[i] + atlas->glyphs[g].src.w);
+                pen += atlas->glyphs[g].advance;
+        }
+        return SDL_max(textW, pen);
+}
 
-        SDL_Rect dst = {
-                .x = container.x,
-                .y = container.y,
-                .w = drawW,
-                .h = drawH
-        };
+// Measured from pairs of glyphs as whole text lays them out. The font's kerning table alone misses
+// what a shaping SDL_ttf (2.20 and up) does, Comfortaa digits come out 5 to 7 pixels closer
+static void font_atlas_kerning(GlyphAtlas *atlas, TTF_Font *font) {
+        int single[ATLAS_GLYPH_COUNT] = { 0 };
+        char pair[3] = { 0 };
+        for (int a = 0; a < ATLAS_GLYPH_COUNT; a++) {
+                pair[0] = ATLAS_FIRST_GLYPH + a;
+                TTF_SizeUTF8(font, pair, &single[a], NULL);
+        }
+        for (int a = 0; a < ATLAS_GLYPH_COUNT; a++) {
+                for (int b = 0; b < ATLAS_GLYPH_COUNT; b++) {
+                        int w = single[a] + single[b];
+                        pair[0] = ATLAS_FIRST_GLYPH + a;
+                        pair[1] = ATLAS_FIRST_GLYPH + b;
+                        TTF_SizeUTF8(font, pair, &w, NULL);
+                        atlas->kerning[a][b] = w - single[a] - single[b];
+                }
+        }
+}
 
-        SDL_RenderCopy(renderer, texture, NULL, &dst);
+static GlyphAtlas* font_build_atlas(FontData *data, SDL_Renderer *renderer, const char *font_path, int fontSize, uint8_t style) {
+        TTF_Font *font = font_get(data, font_path, fontSize, style);
+        if (!font) return NULL;
+
+        // 1. Rasterize every glyph white and shelf pack them, one row after the other
+        SDL_Surface *surfaces[ATLAS_GLYPH_COUNT] = { 0 };
+        AtlasGlyph glyphs[ATLAS_GLYPH_COUNT] = { 0 };
+        SDL_Color white = { 255, 255, 255, 255 };
+        int penX = 0, penY = 0, rowHeight = 0;
+        int lineHeight = TTF_FontHeight(font);
+        int ascent = TTF_FontAscent(font);
+        bool layoutKnown = true;
+
+        for (int i = 0; i < ATLAS_GLYPH_COUNT; i++) {
+                Uint16 ch = ATLAS_FIRST_GLYPH + i;
+                int minx, maxx, miny, maxy, advance;
+                if (TTF_GlyphMetrics(font, ch, &minx, &maxx, &miny, &maxy, &advance) != 0) {
+                        continue;
+                }
+                glyphs[i].advance = advance;
+
+                surfaces[i] = TTF_RenderGlyph_Blended(font, ch, white);
+                if (!surfaces[i]) continue; // Space and friends can come back empty
+
+                // SDL_ttf versions lay glyph surfaces out differently: from the top of the line at the pen (or left
+                // of it) and at least a line high, descenders can hang below. Or cropped to the glyph box.
+                // Anything else goes through whole text
+                if (surfaces[i]->h >= lineHeight && maxy <= ascent) {
+                        glyphs[i].xOffset = SDL_min(minx, 0);
+                        glyphs[i].yOffset = 0;
+                } else if (surfaces[i]->h == maxy - miny) {
+                        glyphs[i].xOffset = minx;
+                        glyphs[i].yOffset = ascent - maxy;
+                } else {
+                        layoutKnown = false;
+                }
+
+                if (penX + surfaces[i]->w > ATLAS_WIDTH) {
+                        penX = 0;
+                        penY += rowHeight + 1;
+                        rowHeight = 0;
+                }
+                glyphs[i].src = (SDL_Rect) { penX, penY, surfaces[i]->w, surfaces[i]->h };
+                penX += surfaces[i]->w + 1; // 1px gap, no bleeding when scaled down
+                rowHeight = SDL_max(rowHeight, surfaces[i]->h);
+        }
+
+        // 2. Copy them into one surface, then one texture
+        SDL_Texture *texture = NULL;
+        SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, penY + rowHeight, 32, SDL_PIXELFORMAT_RGBA32);
+        if (atlas) {
+                for (int i = 0; i < ATLAS_GLYPH_COUNT; i++) {
+                        if (!surfaces[i]) continue;
+                        SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE); // Copy alpha as is
+                        SDL_BlitSurface(surfaces[i], NULL, atlas, &glyphs[i].src);
+                }
+                texture = SDL_CreateTextureFromSurface(renderer, atlas);
+                SDL_FreeSurface(atlas);
+        }
+        for (int i = 0; i < ATLAS_GLYPH_COUNT; i++) {
+                SDL_FreeSurface(surfaces[i]);
+        }
+        if (!texture) return NULL;
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+        // 3. Add to array
+        if (data->ga_count >= data->ga_capacity) {
+                int capacity = data->ga_capacity ? data->ga_capacity * 2 : 2;
+                GlyphAtlas *atlases = realloc(data->atlases, sizeof(GlyphAtlas) * capacity);
+                if (!atlases) {
+                        SDL_DestroyTexture(texture);
+                        return NULL;
+                }
+                data->atlases = atlases;
+                data->ga_capacity = capacity;
+        }
+
+        GlyphAtlas *entry = &data->atlases[data->ga_count++];
+        entry->fontPath = font_path;
+        entry->fontSize = fontSize;
+        entry->style = style;
+        entry->texture = texture;
+        entry->lineHeight = lineHeight;
+        memcpy(entry->glyphs, glyphs, sizeof(glyphs));
+        font_atlas_kerning(entry, font);
+
+        // Must come out as wide as rendered text, or labels would shift between the two. Shaping places
+        // glyphs at subpixel positions, whole pixel pairs can drift a pixel or two over a line
+        const char *sample = "Score: 0123456789";
+        int penXs[32], textW = 0;
+        bool sameWidth = TTF_SizeUTF8(font, sample, &textW, NULL) == 0 && abs(font_atlas_layout(entry, sample, strlen(sample), penXs) - textW) <= 2;
+        if (!layoutKnown || !sameWidth) {
+                fprintf(stderr, "Font atlas: glyphs of %s at %d don't line up with rendered text, drawing it whole\n", font_path, fontSize);
+                SDL_DestroyTexture(texture);
+                entry->texture = NULL; // Kept so it isn't built again
+        }
+        return entry;
+}
+
+static GlyphAtlas* font_get_atlas(FontData *data, SDL_Renderer *renderer, const char *font_path, int fontSize, uint8_t style) {
+        for (int i = 0; i < data->ga_count; i++) {
+                GlyphAtlas *atlas = &data->atlases[i];
+                if (atlas->fontSize == fontSize && atlas->style == style && strcmp(atlas->fontPath, font_path) == 0) {
+                        return atlas->texture? atlas: NULL;
+                }
+        }
+        GlyphAtlas *atlas = font_build_atlas(data, renderer, font_path, fontSize, style);
+        return (atlas && atlas->texture)? atlas: NULL;
+}
+
+void font_render_rect_atlas(
+        FontData *data,
+        SDL_Renderer *renderer,
+        const char *text,
+        const char *font_path,
+        int fontSize,
+        uint8_t fontStyle,
+        SDL_Color color,
+        SDL_Rect container
+) {
+        if (!data || !renderer || !text) return;
+
+        // Use base font size if -1
+        int actualSize = (fontSize == -1) ? BASE_FONT_SIZE : fontSize;
+
+        size_t length = strlen(text);
+        bool printable = length > 0 && length < 256;
+        for (size_t i = 0; printable && i < length; i++) {
+                printable = (uint8_t)text[i] >= ATLAS_FIRST_GLYPH && (uint8_t)text[i] < ATLAS_FIRST_GLYPH + ATLAS_GLYPH_COUNT;
+        }
+
+        GlyphAtlas *atlas = printable ? font_get_atlas(data, renderer, font_path, actualSize, fontStyle) : NULL;
+        if (!atlas) {
+                font_render_rect(data, renderer, text, font_path, fontSize, fontStyle, color, container);
+                return;
+        }
+
+        // 1. Lay the line out at full size
+        int penX[256];
+        int textW = font_atlas_layout(atlas, text, length, penX);
+        int textH = atlas->lineHeight;
+        if (textW <= 0 || textH <= 0) return;
+
+        // 2. Scale to fit container (keep aspect ratio), centered
+        float scale = SDL_min((float)container.w / textW, (float)container.h / textH);
+        scale = SDL_min(scale, 1.0f);
+        float originX = container.x + (container.w - (int)(textW * scale)) / 2;
+        float originY = container.y + (container.h - (int)(textH * scale)) / 2;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        // 3. One quad per glyph, all in a single draw
+        SDL_Vertex vertices[256 * 4];
+        int indices[256 * 6];
+        int quads = 0;
+        int atlasW, atlasH;
+        SDL_QueryTexture(atlas->texture, NULL, NULL, &atlasW, &atlasH);
+
+        for (size_t i = 0; i < length; i++) {
+                const SDL_Rect *src = &atlas->glyphs[(uint8_t)text[i] - ATLAS_FIRST_GLYPH].src;
+                if (src->w == 0 || src->h == 0) continue;
+
+                int yOffset = atlas->glyphs[(uint8_t)text[i] - ATLAS_FIRST_GLYPH].yOffset;
+                float x0 = originX + penX[i] * scale, x1 = x0 + src->w * scale;
+                float y0 = originY + yOffset * scale, y1 = y0 + src->h * scale;
+                float u0 = (float)src->x / atlasW, u1 = (float)(src->x + src->w) / atlasW;
+                float v0 = (float)src->y / atlasH, v1 = (float)(src->y + src->h) / atlasH;
+
+                SDL_Vertex *v = &vertices[quads * 4];
+                v[0] = (SDL_Vertex) { { x0, y0 }, color, { u0, v0 } };
+                v[1] = (SDL_Vertex) { { x1, y0 }, color, { u1, v0 } };
+                v[2] = (SDL_Vertex) { { x1, y1 }, color, { u1, v1 } };
+                v[3] = (SDL_Vertex) { { x0, y1 }, color, { u0, v1 } };
+
+                int *idx = &indices[quads * 6];
+                int base = quads * 4;
+                idx[0] = base; idx[1] = base + 1; idx[2] = base + 2;
+                idx[3] = base; idx[4] = base + 2; idx[5] = base + 3;
+                quads++;
+        }
+        if (quads > 0) {
+                SDL_RenderGeometry(renderer, atlas->texture, vertices, quads * 4, indices, quads * 6);
+                drawCallCount++;
+        }
+#else
+        // 3. Older SDL: tint the atlas, one copy per glyph
+        SDL_SetTextureColorMod(atlas->texture, color.r, color.g, color.b);
+        SDL_SetTextureAlphaMod(atlas->texture, color.a);
+        for (size_t i = 0; i < length; i++) {
+                const SDL_Rect *src = &atlas->glyphs[(uint8_t)text[i] - ATLAS_FIRST_GLYPH].src;
+                if (src->w == 0 || src->h == 0) continue;
+
+                int yOffset = atlas->glyphs[(uint8_t)text[i] - ATLAS_FIRST_GLYPH].yOffset;
+                SDL_FRect dst = { originX + penX[i] * scale, originY + yOffset * scale, src->w * scale, src->h * scale };
+                SDL_RenderCopyF(renderer, atlas->texture, src, &dst);
+                drawCallCount++;
+        }
+#endif
 }
 
 void fontData_destroy(FontData *FD) {
@@ -194,10 +528,16 @@ void fontData_destroy(FontData *FD) {
         }
         free(FD->fontEntries);
 
-        for (int i = 0; i < FD->ct_count; i++) {
+        for (int i = 0; i < FD->ct_capacity; i++) {
                 if (FD->cachedTexts[i].texture) {
                         SDL_DestroyTexture(FD->cachedTexts[i].texture);
                 }
         }
         free(FD->cachedTexts);
+        free(FD->ct_buckets);
+
+        for (int i = 0; i < FD->ga_count; i++) {
+                SDL_DestroyTexture(FD->atlases[i].texture);
+        }
+        free(FD->atlases);
 }
\ No newline at end of file
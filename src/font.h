@@ -21,22 +21,68 @@ typedef struct {
         int fontSize;
         uint8_t style;
         SDL_Color color;
+
+        uint32_t hash;
+        int nextInBucket; // Hash chain, or free list for unused slots. -1 ends it
+        int lruPrev, lruNext; // Towards most / least recently used, -1 at the ends
 } CachedText;
 
+// Printable ASCII, enough for scores and labels
+#define ATLAS_FIRST_GLYPH 32
+#define ATLAS_GLYPH_COUNT 95
+
+typedef struct {
+        SDL_Rect src; // In the atlas texture
+        int xOffset; // From the pen position, glyphs can start left of it
+        int yOffset; // From the top of the line
+        int advance;
+} AtlasGlyph;
+
+typedef struct {
+        // Every glyph of one font/size/style rasterized once into one texture
+        const char *fontPath;
+        int fontSize;
+        uint8_t style;
+
+        SDL_Texture *texture; // White glyphs, tinted per draw. NULL: glyphs didn't line up with whole text, not used
+        int lineHeight;
+        AtlasGlyph glyphs[ATLAS_GLYPH_COUNT];
+        int16_t kerning[ATLAS_GLYPH_COUNT][ATLAS_GLYPH_COUNT]; // [left][right], added to the left glyph's advance
+} GlyphAtlas;
+
 typedef struct {
-        CachedText *cachedTexts;
+        // Rendered text cache: hashed on (text, font, size, style, color), least recently used goes first
+        CachedText *cachedTexts; // ct_capacity slots
         int ct_count;
-        int ct_capacity;
+        int ct_capacity; // Entry budget
+        int *ct_buckets;
+        int ct_bucketMask;
+        int ct_lruHead, ct_lruTail;
+        int ct_freeHead;
+        size_t ct_bytes; // Texture memory held, estimated as w * h * 4
+        size_t ct_byteBudget;
+
+        unsigned ct_hits, ct_misses, ct_evictions;
 
         FontEntry *fontEntries;
         int fe_count;
         int fe_capacity;
+
+        GlyphAtlas *atlases;
+        int ga_count;
+        int ga_capacity;
 } FontData;
 
 
 // Font Specific Functions
-int fontData_init(FontData *);
+int fontData_init(FontData *); // Cache budget from config.h
+int fontData_init_budget(FontData *, int maxTexts, size_t maxBytes);
 void font_render_rect(FontData *, SDL_Renderer *, const char *txt, const char *font_path, int fontSize, uint8_t fontStyle, SDL_Color txtColor, SDL_Rect txtContainer);
+// Same as font_render_rect but drawn glyph by glyph from an atlas: new text costs no rasterizing
+// and no texture, for labels that change all the time (scores). Anything but one line of
+// printable ASCII goes through font_render_rect, so does everything when the atlas glyphs
+// don't measure up to rendered text
+void font_render_rect_atlas(FontData *, SDL_Renderer *, const char *txt, const char *font_path, int fontSize, uint8_t fontStyle, SDL_Color txtColor, SDL_Rect txtContainer);
 void fontData_destroy(FontData *);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "frames.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_FRESH 4 // Next to the buffer index in ready: published and not taken yet
+
+static inline void orRows(uint64_t* into, const uint64_t* rows, int words) {
+        for (int i = 0; i < words; i++) {
+                into[i] |= rows[i];
+        }
+}
+
+bool frames_init(SimFrames* F, GameData* GD, uint64_t time) {
+        int width = GD->config.width;
+        int height = GD->config.height;
+        int rowWords = DIRTY_ROW_WORDS(height);
+        size_t cells = (size_t) width * height;
+
+        // Per buffer dirty, marked and stale rows, then unseen and the scratch. Grids after that
+        size_t words = (size_t) (3 * SIM_FRAME_BUFFERS + 2) * rowWords;
+        F->memory = malloc(words * sizeof(uint64_t) + SIM_FRAME_BUFFERS * cells);
+        if (F->memory == NULL) {
+                fprintf(stderr, "Frames: out of memory\n");
+                return false;
+        }
+
+        uint64_t* word = F->memory;
+        uint8_t* grid = (uint8_t*) (word + words);
+        for (int b = 0; b < SIM_FRAME_BUFFERS; b++) {
+                F->frames[b] = (SimFrame) {
+                        .grid = grid + b * cells,
+                        .dirtyRows = word,
+                        .markedRows = word + rowWords,
+                        .width = width,
+                        .height = height,
+                };
+                F->stale[b] = word + 2 * rowWords;
+                memset(F->stale[b], 0xff, sizeof(uint64_t) * rowWords); // Nothing copied into it yet
+                word += 3 * rowWords;
+        }
+        F->unseen = word;
+        F->rows = word + rowWords;
+        memset(F->unseen, 0xff, sizeof(uint64_t) * rowWords); // The reader has nothing yet
+        F->rowWords = rowWords;
+        F->published = 0;
+
+        // The reader holds 0, never shown since a fresh frame is waiting before this returns.
+        // 2 is marked fresh so the first publish doesn't count it as taken
+        F->front = 0;
+        F->back = 1;
+        atomic_init(&F->ready, 2 | FRAME_FRESH);
+        frames_publish(F, GD, &GD->currentTetromino, time);
+        return true;
+}
+
+void frames_publish(SimFrames* F, GameData* GD, const TetrominoData* previous, uint64_t time) {
+        SimFrame* frame = &F->frames[F->back];
+        int words = F->rowWords;
+        sim_takeDirtyRows(GD, F->rows);
+
+        // These rows are now out of date in the other buffers too, this one gets everything it missed
+        for (int b = 0; b < SIM_FRAME_BUFFERS; b++) {
+                orRows(F->stale[b], F->rows, words);
+        }
+        uint64_t* stale = F->stale[F->back];
+        for (int w = 0; w < words; w++) {
+                uint64_t bits = stale[w];
+                while (bits) {
+                        int y = w * 64 + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        if (y >= frame->height) {
+                                break;
+                        }
+                        memcpy(frame->grid + (size_t) y * frame->width, sim_row(GD, y), frame->width);
+                }
+                stale[w] = 0;
+        }
+
+        // Everything since the newest frame the reader surely took, it may well have a newer one
+        for (int w = 0; w < words; w++) {
+                frame->dirtyRows[w] = F->unseen[w] | F->rows[w];
+        }
+        memset(frame->markedRows, 0, sizeof(uint64_t) * words);
+        if (GD->markedSandCount > 0) {
+                for (int y = 0; y < frame->height; y++) {
+                        if (GD->markedInRow[y]) {
+                                frame->markedRows[y >> 6] |= 1ull << (y & 63);
+                        }
+                }
+        }
+
+        frame->tick = ++F->published;
+        frame->time = time;
+        frame->score = GD->score;
+        frame->gameStarted = GD->gameStarted;
+        frame->gamePaused = GD->gamePaused;
+        frame->gameOver = GD->gameOver;
+        frame->current = GD->currentTetromino;
+        frame->previous = *previous;
+        frame->ghost = GD->ghostTetromino;
+        frame->next = GD->nextTetromino;
+        frame->flash = sim_effectProgress(GD, SIM_EFFECT_CLEAR_FLASH);
+
+        int old = atomic_exchange_explicit(&F->ready, F->back | FRAME_FRESH, memory_order_acq_rel);
+        F->back = old & ~FRAME_FRESH;
+        if (old & FRAME_FRESH) {
+                orRows(F->unseen, F->rows, words); // Dropped untaken, the reader still lacks its rows
+        } else {
+                memcpy(F->unseen, F->rows, sizeof(uint64_t) * words); // The reader swapped it back: it took the one before this
+        }
+}
+
+const SimFrame* frames_take(SimFrames* F, bool* isNew) {
+        *isNew = false;
+        if (atomic_load_explicit(&F->ready, memory_order_acquire) & FRAME_FRESH) {
+                // Only the publisher marks fresh, so whatever this swaps out is fresh too, maybe newer
+                int taken = atomic_exchange_explicit(&F->ready, F->front, memory_order_acq_rel);
+                F->front = taken & ~FRAME_FRESH;
+                *isNew = true;
+        }
+        return &F->frames[F->front];
+}
+
+void frames_free(SimFrames* F) {
+        free(F->memory);
+        F->memory = NULL;
+}
@@ -0,0 +1,57 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+// Triple buffered hand over of what the screen needs from the simulation.
+// One thread publishes a frame after its ticks, another takes the newest one and draws it.
+// Neither ever waits: the publisher always has a buffer of its own, the reader keeps the frame
+// it took until it takes the next one, so it never sees one half written.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "simulation.h"
+
+typedef struct {
+        uint8_t* grid; // colorGrid as of this frame, height rows of width
+        uint64_t* dirtyRows; // DIRTY_ROW_WORDS(height). Changed since any frame the reader took before, a superset
+        uint64_t* markedRows; // Rows holding marked sand, their shimmer is redrawn every frame
+        int width, height;
+
+        uint64_t tick; // Published frames so far, this one included
+        uint64_t time; // Publisher's clock when the last tick was due, for blending previous -> current
+        unsigned score;
+        bool gameStarted, gamePaused, gameOver;
+        TetrominoData current, previous, ghost, next; // previous: the falling piece one tick earlier
+        float flash; // sim_effectProgress of SIM_EFFECT_CLEAR_FLASH
+} SimFrame;
+
+#define SIM_FRAME_BUFFERS 3
+
+typedef struct {
+        SimFrame frames[SIM_FRAME_BUFFERS];
+        void* memory;
+        int rowWords; // DIRTY_ROW_WORDS(height)
+
+        // Publisher side
+        int back; // Being written
+        uint64_t* stale[SIM_FRAME_BUFFERS]; // Rows of each buffer's grid older than the sim's
+        uint64_t* unseen; // Rows changed since the newest frame the reader surely took
+        uint64_t* rows; // Scratch for sim_takeDirtyRows
+        uint64_t published;
+
+        // Reader side
+        int front; // Taken, stays put until the next frames_take
+
+        atomic_int ready; // Newest published buffer | FRAME_FRESH until the reader takes it
+} SimFrames;
+
+// Publishes the current state of GD as the first frame
+bool frames_init(SimFrames*, GameData* GD, uint64_t time);
+// Publisher: copies out what changed since the buffer was last written, then swaps it in.
+// Takes GD's dirty rows, nothing else may
+void frames_publish(SimFrames*, GameData* GD, const TetrominoData* previous, uint64_t time);
+// Reader: the newest frame, valid until the next call. isNew: not returned before
+const SimFrame* frames_take(SimFrames*, bool* isNew);
+void frames_free(SimFrames*);
+
+#endif
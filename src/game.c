@@ -2,7 +2,10 @@
 #include "Audio.h"
 #include "HighScore.h"
 #include "config.h"
+#include "drawbatch.h"
+#include "drawstats.h"
 #include "font.h"
+#include "trace.h"
 #include <SDL2/SDL_pixels.h>
 #include <SDL2/SDL_scancode.h>
 #include <SDL2/SDL_stdinc.h>
@@ -21,74 +24,22 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define unpack_color(color) (color.r), (color.g), (color.b), (color.a)
-#define randColor() (rand() % COLOR_COUNT)
-#define randRotation() (rand() % 4) // 4 rotations total so MAGIC NUMBER
 
-// One time Function
-static inline void InitializeTetriminoCollection(TetrominoCollection* TC);
-static inline void CleanUpTetriminoCollection(TetrominoCollection* TC);
-
-// Other functions
-static void destroyCurrentTetromino(GameData* GD);
 static SDL_Color enumToColor(ColorCode CC);
-static SDL_Rect TetrominoBounds(TetrominoData* TD);
-
-static void renderTetrimino(SDL_Renderer* renderer, const TetrominoData* t, bool ghostBlock);
-
-// This function called to create new tetrimino
-// For currentTetrimino once in init
-// For every nextTetrimino determination
-static void InitializeTetriminoData(TetrominoCollection* TC, TetrominoData* TD) {
-        TD->shape = &TC->tetrominos[rand() % TC->count]; // Chosing 1 of random tetrimino from the collection
 
-        TD->color = randColor();
-        TD->rotation = randRotation();
-
-        TD->velY = GRAVITY;
-
-        TD->x = 0;
-        TD->y = 0;
-}
+static void renderTetrimino(DrawBatch* batch, const TetrominoData* t, bool ghostBlock);
 
 static inline void _game_init_(GameContext* GC) {
         audio_playMusic(&GC->audioData, BG_MUSIC);
         getScores(GC->HIGH_SCORES); // TODO: on gameOver, add current score to it
-
-        // Game Data Initialization
-        GameData* GD = &GC->gameData;
-
-        GD->gameOver = false;
-        GC->gameData.gamePaused = false;
-
-        GD->sandRemoveTrigger = false;
-        GD->score = 0;
-
-        // Initializing colorGrid to have no sand particles
-        for (int i = 0; i < GAME_HEIGHT; i++) {
-                for (int j = 0; j < GAME_WIDTH; j++) {
-                        GD->colorGrid[i][j] = COLOR_NONE;
-                }
-        }
-
-        // Initialize Current Tetrimono
-        InitializeTetriminoData(&GD->tetrominoCollection, &GD->currentTetromino);
-        SDL_Rect rect = TetrominoBounds(&GD->currentTetromino);
-        GD->currentTetromino.x = GAME_POS_X + (GAME_WIDTH - rect.w) * 0.5f - rect.x;
-        GD->currentTetromino.y = GAME_POS_Y - rect.h;
-
-        GD->ghostTetromino = GD->currentTetromino;
-
-        // Initialize Next Tetrimono
-        InitializeTetriminoData(&GD->tetrominoCollection, &GD->nextTetromino);
-        rect = TetrominoBounds(&GD->nextTetromino);
-        GD->nextTetromino.x = INFO_PANEL_X + (INFO_PANEL_WIDTH - rect.w) * 0.5f - rect.x;
-        GD->nextTetromino.y = INFO_PANEL_Y + (INFO_PANEL_HEIGHT) * 0.05f;
 }
 
 bool game_init(GameContext* GC) {
-        srand(time(NULL)); // Seeding the random with current time
+        uint64_t seed = time(NULL); // Seeding the random with current time
+        rng_seed(&GC->renderRng, ~seed);
         if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
                 fprintf(stderr, "SDL_Init error: %s\n", SDL_GetError());
                 return false;
@@ -180,14 +131,16 @@ bool game_init(GameContext* GC) {
         GC->window = window;
         GC->renderer = renderer;
         GC->texture = texture;
+        GC->uiLayer = NULL; // Made on first use, sized for the output
+        GC->uiLayerValid = false;
         GC->fontData = fontData;
         GC->pixelFormat = SDL_AllocFormat(fmt);
+        buildPalette(GC);
         GC->audioData = audio;
         GC->running = true;
         GC->last_time = SDL_GetTicks();
         GC->delta_time = 0.0f;
         GC->keys = SDL_GetKeyboardState(NULL);
-        InitializeTetriminoCollection(&GC->gameData.tetrominoCollection);
 
         // Music slider
         GC->musicSlider = malloc(sizeof(AudioSlider));
@@ -202,7 +155,37 @@ bool game_init(GameContext* GC) {
                 return -1;
         }
 
-        GC->gameData.gameStarted = false;
+        // The screen layout is made for this size, texture and sim have to agree
+        if (!sim_init(&GC->gameData, sim_defaultConfig(), seed)) {
+                fprintf(stderr, "Simulation Initialization Error!\n");
+                free(GC->musicSlider);
+                free(GC->sfxSlider);
+                audio_cleanup(&GC->audioData);
+                fontData_destroy(&fontData);
+                SDL_DestroyTexture(texture);
+                SDL_DestroyRenderer(renderer);
+                SDL_DestroyWindow(window);
+                SDL_Quit();
+                return false;
+        }
+        replay_init(&GC->replay, GC->gameData.config, seed, GC->gameData.stepper);
+
+        // From here on the sim thread owns gameData, the first frame is there before it starts
+        if (!frames_init(&GC->frames, &GC->gameData, SDL_GetPerformanceCounter()) || !simthread_start(&GC->simThread, &GC->gameData, &GC->replay, &GC->frames)) {
+                frames_free(&GC->frames);
+                replay_free(&GC->replay);
+                sim_cleanup(&GC->gameData);
+                free(GC->musicSlider);
+                free(GC->sfxSlider);
+                audio_cleanup(&GC->audioData);
+                fontData_destroy(&fontData);
+                SDL_DestroyTexture(texture);
+                SDL_DestroyRenderer(renderer);
+                SDL_DestroyWindow(window);
+                SDL_Quit();
+                return false;
+        }
+        GC->frame = frames_take(&GC->frames, &GC->frameIsNew);
         _game_init_(GC);
 
         *GC->musicSlider = (AudioSlider){
@@ -229,7 +212,16 @@ bool game_init(GameContext* GC) {
         return true;
 }
 
+static void onGameOver(GameContext* GC) {
+        audio_stopMusic(&GC->audioData);
+        if (postScore(GC->frame->score)) {
+                getScores(GC->HIGH_SCORES);
+        }
+        audio_playSFX(&GC->audioData, SFX_GAME_OVER);
+}
+
 void game_handle_events(GameContext* GC) {
+        TraceZone zone = trace_begin("game_handle_events");
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
                 switch (event.type) {
@@ -253,6 +245,13 @@ void game_handle_events(GameContext* GC) {
                                 break;
                         }
 
+                        // Render target contents are gone (Direct3D device lost, ...)
+                        case SDL_RENDER_TARGETS_RESET:
+                        case SDL_RENDER_DEVICE_RESET: {
+                                GC->uiLayerValid = false;
+                                break;
+                        }
+
                         case SDL_KEYDOWN: {
                                 switch (event.key.keysym.sym) {
                                         case SDLK_ESCAPE: {
@@ -260,49 +259,30 @@ void game_handle_events(GameContext* GC) {
                                                         GC->running = false;
                                                 }
 
-                                                GC->gameData.gamePaused = !GC->gameData.gamePaused;
+                                                simthread_press(&GC->simThread, SIM_INPUT_PAUSE);
                                                 break;
                                         }
 
                                         case SDLK_UP:
                                         case SDLK_w: {
-                                                if (GC->gameData.gameOver || GC->gameData.gameStarted == false) {
-                                                        return;
-                                                }
-                                                if (TetrominoBounds(&GC->gameData.currentTetromino).y < GAME_POS_Y) {
-                                                        break;
-                                                }
-
-                                                GC->gameData.currentTetromino.rotation = (GC->gameData.currentTetromino.rotation + 1) % 4;
+                                                simthread_press(&GC->simThread, SIM_INPUT_ROTATE_CW);
                                                 break;
                                         }
 
                                         case SDLK_DOWN:
                                         case SDLK_s: {
-                                                if (GC->gameData.gameOver || GC->gameData.gameStarted == false) {
-                                                        return;
-                                                }
-                                                if (TetrominoBounds(&GC->gameData.currentTetromino).y < GAME_POS_Y) {
-                                                        break;
-                                                }
-
-                                                if (GC->gameData.currentTetromino.rotation > 0) {
-                                                        GC->gameData.currentTetromino.rotation = GC->gameData.currentTetromino.rotation - 1;
-                                                } else {
-                                                        GC->gameData.currentTetromino.rotation = 3;
-                                                }
+                                                simthread_press(&GC->simThread, SIM_INPUT_ROTATE_CCW);
                                                 break;
                                         }
 
                                         case SDLK_SPACE: {
-                                                if (GC->gameData.gameOver || GC->gameData.gameStarted == false) {
-                                                        return;
-                                                }
+                                                simthread_press(&GC->simThread, SIM_INPUT_HARD_DROP);
+                                                break;
+                                        }
 
-                                                SDL_Rect rect = TetrominoBounds(&GC->gameData.currentTetromino);
-                                                if (rect.y >= GAME_POS_Y) {
-                                                        GC->gameData.currentTetromino.y = GC->gameData.ghostTetromino.y;
-                                                        destroyCurrentTetromino(&GC->gameData);
+                                        case SDLK_F12: {
+                                                if (trace_dump(TRACE_FILE)) {
+                                                        printf("Trace written to %s\n", TRACE_FILE);
                                                 }
                                                 break;
                                         }
@@ -310,8 +290,7 @@ void game_handle_events(GameContext* GC) {
                                         case SDLK_0: {
                                                 if (!DEBUG) break;
 
-                                                GC->gameData.score = 10000;
-                                                GC->gameData.gameOver = true;
+                                                simthread_forceGameOver(&GC->simThread); // Comes back as SIM_EVENT_GAME_OVER
                                                 break;
                                         }
                                 }
@@ -320,352 +299,69 @@ void game_handle_events(GameContext* GC) {
                 }
         }
 
-        if (GC->gameData.gameOver || GC->gameData.gameStarted == false) {
-                if (GC->keys[SDL_SCANCODE_RETURN] || GC->keys[SDL_SCANCODE_KP_ENTER]) {
-                        GC->gameData.gameStarted = true;
-                        _game_init_(GC);
-                }
-                return;
+        // Held keys
+        if (GC->keys[SDL_SCANCODE_RETURN] || GC->keys[SDL_SCANCODE_KP_ENTER]) {
+                simthread_press(&GC->simThread, SIM_INPUT_START);
         }
-
-        // Move Current Tetrimino
-        // TODO: smoother control
-        TetrominoData* TD = &GC->gameData.currentTetromino;
+        SimInput held = SIM_INPUT_NONE;
         if (GC->keys[SDL_SCANCODE_LEFT] || GC->keys[SDL_SCANCODE_A]) {
-                TD->x -= TETRIMINO_MOVE_SPEED * GC->delta_time;
+                held |= SIM_INPUT_LEFT;
         }
         if (GC->keys[SDL_SCANCODE_RIGHT] || GC->keys[SDL_SCANCODE_D]) {
-                TD->x += TETRIMINO_MOVE_SPEED * GC->delta_time;
-        }
-
-        // Clamp position: to inbetween walls
-        int minCol = 4;
-        int maxCol = -1;
-        const unsigned short (*shape)[4] = TD->shape->shape[TD->rotation];
-        for (int row = 0; row < 4; row++) {
-                for (int col = 0; col < 4; col++) {
-                        if (shape[row][col]) {
-                                if (col < minCol) minCol = col;
-                                if (col > maxCol) maxCol = col;
-                        }
-                }
-        }
-
-        int minX = GAME_POS_X + -minCol * PARTICLE_COUNT_IN_BLOCK_COLUMN;
-        int maxX = GAME_POS_X + GAME_WIDTH - (maxCol + 1) * PARTICLE_COUNT_IN_BLOCK_COLUMN;
-        TD->x = SDL_clamp(TD->x, minX, maxX);
-}
-
-// Also Updates score
-static void removeParticlesGracefully(GameContext* GC) {
-        int (*colorGrid)[GAME_WIDTH] = GC->gameData.colorGrid;
-        static float timer = 0.0f;
-        timer += GC->delta_time;
-
-        if (timer > (TIME_FOR_SAND_DELETION - 0.1f)) {
-                audio_playSFX(&GC->audioData, SFX_SAND_CLEAR);
-                SDL_Delay(100);
-
-                for (int y = 0; y < GAME_HEIGHT; y++) {
-                        for (int x = 0; x < GAME_WIDTH; x++) {
-                                if (colorGrid[y][x] == COLOR_DELETE_MARKED_SAND) {
-                                        colorGrid[y][x] = COLOR_NONE;
-                                        GC->gameData.score++;
-                                }
-                        }
-                }
-
-                // Additinal Reward for scoring: half the current falling tetrimino falling
-                GC->gameData.currentTetromino.velY = GC->gameData.currentTetromino.velY * 0.5f;
-
-                GC->gameData.sandRemoveTrigger = false;
-                timer = 0.0f;
-        }
-}
-
-static bool update_sand_particle_falling(int (*colorGrid)[GAME_WIDTH], float deltaTime, unsigned score) {
-        static float sandAccumulator = 0.0f;
-        sandAccumulator += deltaTime;
-
-        bool returnValue = false; // whether sands that need to be removed is in the colorGrid
-
-        int level = floor(score / 1500.0f) + 1;
-        while (sandAccumulator >= SAND_STEP_TIME) { // Move the level, faster sand falls cause for fun!
-                sandAccumulator -= fmax(SAND_STEP_TIME * 1 / 2.5f, (SAND_STEP_TIME / (level / 10.0f + 1)));
-
-                // Process from bottom to top (second-to-bottom row up to top)
-                for (int y = GAME_HEIGHT - 2; y >= 0; y--) {
-                        // Process each column
-                        for (int x = 0; x < GAME_WIDTH; x++) {
-                                // Skip empty cells
-                                if (colorGrid[y][x] == COLOR_NONE) {
-                                        continue;
-                                } else if (colorGrid[y][x] == COLOR_DELETE_MARKED_SAND) {
-                                        returnValue = true;
-                                        continue;
-                                }
-
-                                // Check if cell below is empty
-                                if (colorGrid[y + 1][x] == COLOR_NONE) {
-                                        // Move straight down
-                                        colorGrid[y + 1][x] = colorGrid[y][x];
-                                        colorGrid[y][x] = COLOR_NONE;
-                                        continue;
-                                }
-
-                                int try_left_first = rand() % 2;
-                                if (try_left_first) {
-                                        if (x > 0 && colorGrid[y + 1][x - 1] == COLOR_NONE) {
-                                                colorGrid[y + 1][x - 1] = colorGrid[y][x];
-                                                colorGrid[y][x] = COLOR_NONE;
-                                                continue;
-                                        }
-                                        if (x < GAME_WIDTH - 1 && colorGrid[y + 1][x + 1] == COLOR_NONE) {
-                                                colorGrid[y + 1][x + 1] = colorGrid[y][x];
-                                                colorGrid[y][x] = COLOR_NONE;
-                                                continue;
-                                        }
-                                } else {
-                                        if (x < GAME_WIDTH - 1 && colorGrid[y + 1][x + 1] == COLOR_NONE) {
-                                                colorGrid[y + 1][x + 1] = colorGrid[y][x];
-                                                colorGrid[y][x] = COLOR_NONE;
-                                                continue;
-                                        }
-                                        if (x > 0 && colorGrid[y + 1][x - 1] == COLOR_NONE) {
-                                                colorGrid[y + 1][x - 1] = colorGrid[y][x];
-                                                colorGrid[y][x] = COLOR_NONE;
-                                                continue;
-                                        }
-                                }
-                        }
-                }
-        }
-        return returnValue;
-}
-
-static bool checkTetrominoCollision(GameData* GD, TetrominoData* TD) {
-        const unsigned short (*shape)[4] = TD->shape->shape[TD->rotation];
-
-        for (int row = 0; row < 4; row++) {
-                for (int col = 0; col < 4; col++) {
-                        if (!shape[row][col] || (row < 3 && shape[row + 1][col]))  {
-                                continue;
-                        }
-
-                        // Calculate the actual position of each block within the tetromino
-                        int blockBaseX = TD->x + col * PARTICLE_COUNT_IN_BLOCK_COLUMN;
-                        int blockBaseY = TD->y + row * PARTICLE_COUNT_IN_BLOCK_ROW;
-
-                        // Check each particle within the block
-                        for (int yOff = 0; yOff < PARTICLE_COUNT_IN_BLOCK_ROW; yOff++) {
-                                for (int xOff = 0; xOff < PARTICLE_COUNT_IN_BLOCK_COLUMN; xOff++) {
-                                        int worldX = blockBaseX + xOff;
-                                        int worldY = blockBaseY + yOff;
-
-                                        // Convert to grid coordinates
-                                        int gridX = worldX - GAME_POS_X;
-                                        int gridY = worldY - GAME_POS_Y;
-
-                                        if (gridY < 0) {
-                                                continue;
-                                        }
-
-                                        // Check bounds - collision with walls or floor
-                                        if (gridX < 0 || gridX >= GAME_WIDTH || gridY >= GAME_HEIGHT) {
-                                                return true;
-                                        }
-
-                                        // Check collision with existing particles
-                                        if (GD->colorGrid[gridY][gridX] != COLOR_NONE) {
-                                                return true;
-                                        }
-                                }
-                        }
-                }
-        }
-
-        return false;
-}
-
-static bool floodFillDetectAjacent(int grid[GAME_HEIGHT][GAME_WIDTH], bool visited[GAME_HEIGHT][GAME_WIDTH], int x, int y, ColorCode color) {
-        // Recurive function that somehow works! (TODO: might have some edge cases, check and fix that)
-        if (x < 0 || x >= GAME_WIDTH || y < 0 || y >= GAME_HEIGHT) {
-                return false;
-        }
-
-        if (visited[y][x] || (grid[y][x] != color)) {
-                return false;
-        }
-
-        visited[y][x] = true;
-        bool reachesRight = (x == GAME_WIDTH - 1); // check it any of the particles of same color connected have reached the end
-
-        // 4 Directions
-        reachesRight |= floodFillDetectAjacent(grid, visited, x + 1, y, color); // Right
-        reachesRight |= floodFillDetectAjacent(grid, visited, x - 1, y, color); // Left
-        reachesRight |= floodFillDetectAjacent(grid, visited, x, y + 1, color); // Down
-        reachesRight |= floodFillDetectAjacent(grid, visited, x, y - 1, color); // Up
-
-        return reachesRight;
-}
-
-static void floodFillDetectDiagonal(int grid[GAME_HEIGHT][GAME_WIDTH], bool visited[GAME_HEIGHT][GAME_WIDTH], int x, int y, ColorCode color) {
-        // Recurive function that somehow works! (TODO: might have some edge cases, check and fix that)
-        if (x < 0 || x >= GAME_WIDTH || y < 0 || y >= GAME_HEIGHT) {
-                return;
-        }
-
-        if (visited[y][x] || (grid[y][x] != color)) {
-                return;
-        }
-
-        visited[y][x] = true;
-        // 8 directions
-        for (int dy = -1; dy <= 1; dy++) {
-                for (int dx = -1; dx <= 1; dx++) {
-                        if (dx == 0 && dy == 0) {
-                                continue;
-                        }
-                        floodFillDetectDiagonal(grid, visited, x + dx, y + dy, color);
-                }
-        }
-
-        return;
-}
-
-static inline void sandClearance(GameData* GD) {
-        int (*grid)[GAME_WIDTH] = GD->colorGrid;
-        bool visited[GAME_HEIGHT][GAME_WIDTH] = {false};
-
-        for (ColorCode color = 0; color < COLOR_COUNT; color++) {
-                for (int y = 0; y < GAME_HEIGHT; y++) {
-                        if (grid[y][0] != color) {
-                                continue;
-                        }
-
-                        memset(visited, false, sizeof(visited));
-                        if (floodFillDetectAjacent(grid, visited, 0, y, color))  {
-                                floodFillDetectDiagonal(grid, visited, 0, y, color);
-                                for (int yy = 0; yy < GAME_HEIGHT; yy++) {
-                                        for (int xx = 0; xx < GAME_WIDTH; xx++) {
-                                                if (visited[yy][xx]) {
-                                                        grid[yy][xx] = COLOR_DELETE_MARKED_SAND;
-                                                }
-                                        }
-                                }
-                        }
-                }
+                held |= SIM_INPUT_RIGHT;
         }
-}
-
-static void checkIfGameOver(GameData* GD) {
-        // if sand reaches a hight more than container
-        for (int x = 0; x < GAME_WIDTH; x++) {
-                if (GD->colorGrid[1][x] != COLOR_NONE) {
-                        GD->gameOver = true;
-                        return;
-                }
-        }
-};
-
-// Update ghost tetromino position
-static void updateGhostTetromino(GameData* GD) {
-        // Copy current tetromino properties
-        GD->ghostTetromino = GD->currentTetromino;
-
-        // Move ghost down until it collides
-        while (!checkTetrominoCollision(GD, &GD->ghostTetromino)) {
-                GD->ghostTetromino.y += 1;
-        }
-
-        // Move back up one step since we went one step too far
-        GD->ghostTetromino.y -= 1;
+        simthread_hold(&GC->simThread, held);
+        trace_end(zone);
 }
 
 void game_update(GameContext* GC) {
-        GameData* GD = &GC->gameData;
-        TetrominoData* TD = &GD->currentTetromino;
-
-        if (GD->gameStarted == false || GD->gamePaused) {
-                return;
-        }
+        TraceZone zone = trace_begin("game_update");
 
-        checkIfGameOver(GD);
+        // The ticks run on the sim thread, this picks up what they left behind
+        SimEvents events = simthread_takeEvents(&GC->simThread);
+        bool isNew;
+        GC->frame = frames_take(&GC->frames, &isNew);
+        GC->frameIsNew |= isNew;
 
-        static float game_over_time = 0;
-        if (GD->gameOver) {
-                audio_stopMusic(&GC->audioData);
-                if (game_over_time < 3.0f) {
-                        if (game_over_time == 0) {
-                                if (postScore(GD->score)) {
-                                        getScores(GC->HIGH_SCORES);
-                                }
-                        }
-                        audio_playSFX(&GC->audioData, SFX_GAME_OVER);
-                        game_over_time += GC->delta_time;
-                }
-                return;
-        } else {
-                game_over_time = 0;
+        if (events & SIM_EVENT_STARTED) {
+                _game_init_(GC);
         }
 
-        if ((GD->sandRemoveTrigger = update_sand_particle_falling(GD->colorGrid, GC->delta_time, GC->gameData.score))) {
-                removeParticlesGracefully(GC);
+        if (events & SIM_EVENT_SAND_CLEARED) {
+                audio_playSFX(&GC->audioData, SFX_SAND_CLEAR); // The pause and flash are sim effects now, see sim_startEffect
         }
 
-        // Steps
-        // 1. Check if current tetromino is colliding
-        //      1.a if it is, convert that to sand and add to colorGrid, swap currentTetromino to nextTetromino and spawn newTetromino for nextTetromino
-        //              Note: make sure to set the x, y to different for new tetromino
-        //      1.b if it's not, Update current tetromino's location
-        // Apply gravity and move tetromino
-        float fallSpeed = GRAVITY * (1 + (floor(GC->gameData.score / 1500.0f) + 1) * 0.3f);
-        TD->velY += fallSpeed * GC->delta_time;
-
-        float oldY = TD->y;
-        TD->y += TD->velY * GC->delta_time;
-
-        // Check if the new position causes a collision
-        if (checkTetrominoCollision(GD, TD)) {
-                // Revert to old position
-                TD->y = oldY;
-                TD->velY = 0;
-
-                // Lock the piece in place
-                destroyCurrentTetromino(GD);
+        if (events & SIM_EVENT_GAME_OVER) {
+                onGameOver(GC);
         }
-
-        // Update ghost tetromino position
-        updateGhostTetromino(GD);
-
-        // Maximum clearance algorithm, delete sand, ... score, level, ...
-        // 2. Maximum clearance
-        //      2.a Detect
-        //      2.b Convert all to color_none gracefully i.e go from COLOR_DELETE_MARKED_SAND to COLOR_NONE
-        sandClearance(GD);
+        trace_end(zone);
 }
 
-static void renderSandBlock(SDL_Renderer* renderer, SandBlock* SB, bool ghostBlock) {
-        SDL_Color fillColor = enumToColor(SB->color);
-        if (ghostBlock) {
-                fillColor.a = 150;
-        }
 
-        SDL_Rect SB_Rect = {.x = (int) SB->x, .y = (int) SB->y, .w = PARTICLE_COUNT_IN_BLOCK_COLUMN, .h = PARTICLE_COUNT_IN_BLOCK_ROW};
-        SDL_SetRenderDrawColor(renderer, unpack_color(fillColor));
-        SDL_RenderFillRect(renderer, &SB_Rect);
+// Falling piece somewhere between the last two ticks, so it moves smoothly whatever the frame rate.
+// The frame's time is when its tick was due, by the sim thread's clock which is the same counter
+static TetrominoData interpolatedTetromino(const GameContext* GC) {
+        const SimFrame* frame = GC->frame;
+        TetrominoData t = frame->current;
+        double tickLength = (double) SDL_GetPerformanceFrequency() / SIM_TICK_RATE;
+        float alpha = fmin((SDL_GetPerformanceCounter() - frame->time) / tickLength, 1.0);
+        t.x = frame->previous.x + (t.x - frame->previous.x) * alpha;
+        t.y = frame->previous.y + (t.y - frame->previous.y) * alpha;
+        return t;
+}
 
+// Fills of all blocks first, then their borders: the blocks don't overlap, so the same pixels
+// as block by block but as two runs of one color each
+static void renderTetrimino(DrawBatch* batch, const TetrominoData* t, bool ghostBlock) {
+        SDL_Color fillColor = enumToColor(t->color);
         SDL_Color borderColor = enumToColor(COLOR_DELETE_MARKED_SAND);
         if (ghostBlock) {
+                fillColor.a = 150;
                 borderColor.a = 255 - fillColor.a;
         }
-        SDL_SetRenderDrawColor(renderer, unpack_color(borderColor));
-        SDL_RenderDrawRect(renderer, &SB_Rect);
-}
 
-
-static void renderTetrimino(SDL_Renderer* renderer, const TetrominoData* t, bool ghostBlock) {
-        SandBlock sb = { .color = t->color, .velY = 0 };
+        SDL_Rect blocks[4 * 4];
+        int count = 0;
         const unsigned short (*shape)[4] = t->shape->shape[t->rotation]; // Credit: ChatGPT, didn't know how to make such pointer
         for (int row = 0; row < 4; row++) {
                 for (int col = 0; col < 4; col++) {
@@ -673,85 +369,89 @@ static void renderTetrimino(SDL_Renderer* renderer, const TetrominoData* t, bool
                                 continue;
                         }
 
-                        sb.x = t->x + col * PARTICLE_COUNT_IN_BLOCK_COLUMN;
-                        sb.y = t->y + row * PARTICLE_COUNT_IN_BLOCK_ROW;
-                        renderSandBlock(renderer, &sb, ghostBlock);
+                        blocks[count++] = (SDL_Rect) {
+                                .x = (int) (t->x + col * PARTICLE_COUNT_IN_BLOCK_COLUMN),
+                                .y = (int) (t->y + row * PARTICLE_COUNT_IN_BLOCK_ROW),
+                                .w = PARTICLE_COUNT_IN_BLOCK_COLUMN,
+                                .h = PARTICLE_COUNT_IN_BLOCK_ROW
+                        };
                 }
         }
-}
-
-static SDL_Rect TetrominoBounds(TetrominoData* TD) {
-        // Boundary
-        int minCol = 4;
-        int maxCol = -1;
-        int minRow = 4;
-        int maxRow = -1;
 
-        const unsigned short (*shape)[4] = TD->shape->shape[TD->rotation];
-        for (int row = 0; row < 4; row++) {
-                for (int col = 0; col < 4; col++) {
-                        if (shape[row][col]) {
-                                if (col < minCol) minCol = col;
-                                if (col > maxCol) maxCol = col;
-                                if (row < minRow) minRow = row;
-                                if (row > maxRow) maxRow = row;
-                        }
-                }
+        for (int i = 0; i < count; i++) {
+                drawbatch_fill(batch, blocks[i], fillColor);
+        }
+        for (int i = 0; i < count; i++) {
+                drawbatch_outline(batch, blocks[i], borderColor);
         }
-
-        int pieceLeft = TD->x + minCol * PARTICLE_COUNT_IN_BLOCK_COLUMN;
-        int pieceRight = TD->x + (maxCol + 1) * PARTICLE_COUNT_IN_BLOCK_COLUMN;
-
-        int pieceTop = TD->y + minRow * PARTICLE_COUNT_IN_BLOCK_ROW;
-        int pieceBottom = TD->y + (maxRow + 1) * PARTICLE_COUNT_IN_BLOCK_ROW;
-
-        return (SDL_Rect) {
-                .x = pieceLeft,
-                .w = pieceRight - pieceLeft,
-                .y = pieceTop,
-                .h = pieceBottom - pieceTop,
-        };
 }
 
-static void renderAllParticles(GameContext* GC) {
-        void* pixels;
-        int pitch;
-
-        SDL_LockTexture(GC->texture, NULL, &pixels, &pitch);
-
-        // pixels = raw RGBA buffer
-        Uint32 *p = (Uint32 *)pixels;
-        int pitch32 = pitch / sizeof(Uint32);
-        Uint32 rgba;
-        SDL_Color color;
+// Pixel for every color the grid can hold, mapped once instead of per pixel per frame.
+// Empty cells show the sand background, marked sand gets its shimmer every frame
+void buildPalette(GameContext* GC) {
+        for (int i = 0; i < 256; i++) {
+                ColorCode CC = (i < COLOR_NONE)? (ColorCode) i: COLOR_SAND;
+                GC->palette[i] = SDL_MapRGBA(GC->pixelFormat, unpack_color(enumToColor(CC)));
+        }
+}
 
+void renderAllParticles(GameContext* GC) {
         SDL_Color color_for_delete_marked_sand_defined = enumToColor(COLOR_DELETE_MARKED_SAND);
 
-        int randValue = rand() % 2 == 0 ? 1: -1;
+        int randValue = rng_bit(&GC->renderRng) ? 1: -1;
         SDL_Color color_for_delete_marked_sand = {
-                .r = color_for_delete_marked_sand_defined.r + randValue * rand() % 50,
-                .g = color_for_delete_marked_sand_defined.g + randValue * rand() % 50,
-                .b = color_for_delete_marked_sand_defined.b + randValue * rand() % 50,
+                .r = color_for_delete_marked_sand_defined.r + randValue * (int) rng_below(&GC->renderRng, 50),
+                .g = color_for_delete_marked_sand_defined.g + randValue * (int) rng_below(&GC->renderRng, 50),
+                .b = color_for_delete_marked_sand_defined.b + randValue * (int) rng_below(&GC->renderRng, 50),
                 .a = 255
         };
+        GC->palette[COLOR_DELETE_MARKED_SAND] = SDL_MapRGBA(GC->pixelFormat, unpack_color(color_for_delete_marked_sand));
+
+        // Only rows that changed since the frame drawn last get locked and rewritten, the texture keeps the rest.
+        // Drawing the same frame again only redoes the shimmer
+        const SimFrame* frame = GC->frame;
+        uint64_t dirtyRows[DIRTY_ROW_WORDS(GAME_HEIGHT)];
+        for (int i = 0; i < DIRTY_ROW_WORDS(GAME_HEIGHT); i++) {
+                dirtyRows[i] = frame->markedRows[i] | (GC->frameIsNew? frame->dirtyRows[i]: 0);
+        }
+        GC->frameIsNew = false;
+
+        TraceZone zone = trace_begin("particle upload");
+        const Uint32* palette = GC->palette;
+        int y = 0;
+        while (y < GAME_HEIGHT) {
+                if (!(dirtyRows[y >> 6] & (1ull << (y & 63)))) {
+                        y++;
+                        continue;
+                }
 
-        for (int y = 0; y < GAME_HEIGHT; y++) {
-                for (int x = 0; x < GAME_WIDTH; x++) {
-                        if (GC->gameData.colorGrid[y][x] == COLOR_DELETE_MARKED_SAND) {
-                                rgba = SDL_MapRGBA(GC->pixelFormat, unpack_color(color_for_delete_marked_sand));
-                        } else {
-                                if (GC->gameData.colorGrid[y][x] == COLOR_NONE) {
-                                        color = enumToColor(COLOR_SAND);
-                                } else {
-                                        color = enumToColor(GC->gameData.colorGrid[y][x]);
-                                }
-                                rgba = SDL_MapRGBA(GC->pixelFormat, unpack_color(color));
+                // One lock per run of dirty rows
+                int y0 = y;
+                while (y < GAME_HEIGHT && (dirtyRows[y >> 6] & (1ull << (y & 63)))) {
+                        y++;
+                }
+                SDL_Rect rows = { 0, y0, GAME_WIDTH, y - y0 };
+
+                void* pixels;
+                int pitch;
+                if (SDL_LockTexture(GC->texture, &rows, &pixels, &pitch) != 0) {
+                        continue;
+                }
+
+                // pixels = raw RGBA buffer, starting at row y0
+                Uint32 *p = (Uint32 *)pixels;
+                int pitch32 = pitch / sizeof(Uint32);
+                for (int row = y0; row < y; row++) {
+                        const uint8_t* src = frame->grid + (size_t) row * frame->width;
+                        Uint32* dst = p + (row - y0) * pitch32;
+                        for (int x = 0; x < GAME_WIDTH; x++) {
+                                dst[x] = palette[src[x]];
                         }
-                        p[y * pitch32 + x] = rgba;
                 }
+                SDL_UnlockTexture(GC->texture);
         }
+        trace_end(zone);
 
-        SDL_UnlockTexture(GC->texture);
         SDL_Rect dst = {
                 GAME_POS_X,
                 GAME_POS_Y,
@@ -760,15 +460,27 @@ static void renderAllParticles(GameContext* GC) {
         };
 
         SDL_RenderCopy(GC->renderer, GC->texture, NULL, &dst);
+        drawCallCount++;
 }
 
+// Everything that stays put while playing: background, borders and the side panel
 static void renderGameUI(SDL_Renderer* renderer, GameContext* GC) {
-        SDL_SetRenderDrawColor(renderer, unpack_color(enumToColor(COLOR_BORDER)));
-        SDL_Rect r = { .x = 0, .y = 0, .w = VIRTUAL_WIDTH, .h = VIRTUAL_HEIGHT };
+        const SimFrame* frame = GC->frame;
+
+        // Shapes under the text go in one batch, the sliders next to it in another
+        DrawBatch* batch = &GC->drawBatch;
+        drawbatch_begin(batch, renderer);
+
+        // Virtual ... Background:
+        SDL_Rect r = { 0, 0, VIRTUAL_WIDTH, VIRTUAL_HEIGHT };
+        drawbatch_fill(batch, r, enumToColor(COLOR_BACKGROUND));
+
+        // Game UI: Outermost border
+        drawbatch_outline(batch, r, enumToColor(COLOR_BORDER));
 
         // Game area border
         r.w = (r.w / 3) * 2;
-        SDL_RenderDrawRect(renderer, &r);
+        drawbatch_outline(batch, r, enumToColor(COLOR_BORDER));
 
         // Play field border
         r = (SDL_Rect) {
@@ -777,28 +489,29 @@ static void renderGameUI(SDL_Renderer* renderer, GameContext* GC) {
                 .w = GAME_WIDTH + 2,
                 .h = GAME_HEIGHT + 2,
         };
-        SDL_RenderDrawRect(renderer, &r);
+        drawbatch_outline(batch, r, enumToColor(COLOR_BORDER));
 
         // Render next tetromino preview
-        if (GC->gameData.gameStarted) {
-                renderTetrimino(GC->renderer, &GC->gameData.nextTetromino, false);
+        if (frame->gameStarted) {
+                renderTetrimino(batch, &frame->next, false);
         }
+        drawbatch_flush(batch);
 
         char str[256];
         SDL_Rect txtContainerRect = (SDL_Rect) {
                 .x = INFO_PANEL_X + GAME_PADDING,
-                .y = GC->gameData.nextTetromino.y + PARTICLE_COUNT_IN_BLOCK_ROW * 4,
+                .y = frame->next.y + PARTICLE_COUNT_IN_BLOCK_ROW * 4,
                 .w = INFO_PANEL_WIDTH - GAME_PADDING * 2,
                 .h = 20 * SCALE_FACTOR,
         };
 
         // Next piece label
-        snprintf(str, sizeof(str), "Next: %s", GC->gameData.gameStarted == false? "XXXX XXXXXXX": GC->gameData.nextTetromino.shape->name);
+        snprintf(str, sizeof(str), "Next: %s", frame->gameStarted == false? "XXXX XXXXXXX": frame->next.shape->name);
         font_render_rect(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, enumToColor(COLOR_BORDER), txtContainerRect);
 
         txtContainerRect.y += txtContainerRect.h * 1.2f;
-        snprintf(str, sizeof(str), "Score: %15d", GC->gameData.score);
-        font_render_rect(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, enumToColor(COLOR_BORDER), txtContainerRect);
+        snprintf(str, sizeof(str), "Score: %15d", frame->score);
+        font_render_rect_atlas(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, enumToColor(COLOR_BORDER), txtContainerRect);
 
         // More spacing after score before sliders
         txtContainerRect.y += txtContainerRect.h;
@@ -815,7 +528,7 @@ static void renderGameUI(SDL_Renderer* renderer, GameContext* GC) {
         smallTxtRect.y += smallTxtRect.h * 1.1f;  // Move down from label
         if (GC->musicSlider) {
                 GC->musicSlider->y = smallTxtRect.y;
-                renderSlider(renderer, GC->musicSlider);
+                renderSlider(batch, GC->musicSlider);
         }
 
         // SFX Volume Label
@@ -827,7 +540,7 @@ static void renderGameUI(SDL_Renderer* renderer, GameContext* GC) {
         smallTxtRect.y += smallTxtRect.h * 1.1f;  // Move down from label
         if (GC->sfxSlider) {
                 GC->sfxSlider->y = smallTxtRect.y;
-                renderSlider(renderer, GC->sfxSlider);
+                renderSlider(batch, GC->sfxSlider);
         }
 
         // High scores section
@@ -846,51 +559,137 @@ static void renderGameUI(SDL_Renderer* renderer, GameContext* GC) {
                 } else {
                         snprintf(str, sizeof(str), "%2d. %d", (i + 1), GC->HIGH_SCORES[i]);
                 }
-                font_render_rect(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, enumToColor(COLOR_BORDER), txtContainerRect);
+                font_render_rect_atlas(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, enumToColor(COLOR_BORDER), txtContainerRect);
                 txtContainerRect.y += txtContainerRect.h * 1.1f;
         }
+        drawbatch_flush(batch); // Sliders
+}
+static UiLayerKey uiLayerKeyOf(const GameContext* GC, float scale) {
+        const SimFrame* frame = GC->frame;
+        UiLayerKey key;
+        memset(&key, 0, sizeof(key)); // Padding too
+        key.scale = scale;
+        key.score = frame->score;
+        memcpy(key.highScores, GC->HIGH_SCORES, sizeof(key.highScores));
+        key.musicHandleX = GC->musicSlider? GC->musicSlider->handleX: -1;
+        key.sfxHandleX = GC->sfxSlider? GC->sfxSlider->handleX: -1;
+        key.gameStarted = frame->gameStarted;
+        key.nextShape = frame->next.shape;
+        key.nextRotation = frame->next.rotation;
+        key.nextColor = frame->next.color;
+        key.nextX = frame->next.x;
+        key.nextY = frame->next.y;
+        return key;
 }
+
+// The static part of the screen as one copy of uiLayer, drawn into it again only when the key changed.
+// False when the renderer can't draw into textures, the caller then draws it directly
+static bool drawUiLayer(GameContext* GC) {
+        SDL_Renderer* renderer = GC->renderer;
+        if (!SDL_RenderTargetSupported(renderer)) {
+                return false;
+        }
+
+        // At output resolution, text drawn at the virtual one would come out blocky
+        float scale;
+        SDL_RenderGetScale(renderer, &scale, NULL);
+        UiLayerKey key = uiLayerKeyOf(GC, scale);
+        if (GC->uiLayerValid && memcmp(&key, &GC->uiLayerKey, sizeof(key)) == 0) {
+                SDL_RenderCopy(renderer, GC->uiLayer, NULL, &(SDL_Rect) { 0, 0, VIRTUAL_WIDTH, VIRTUAL_HEIGHT });
+                drawCallCount++;
+                return true;
+        }
+
+        int w = (int) ceilf(VIRTUAL_WIDTH * scale);
+        int h = (int) ceilf(VIRTUAL_HEIGHT * scale);
+        int layerW = 0, layerH = 0;
+        if (GC->uiLayer) {
+                SDL_QueryTexture(GC->uiLayer, NULL, NULL, &layerW, &layerH);
+        }
+        if (layerW != w || layerH != h) {
+                if (GC->uiLayer) {
+                        SDL_DestroyTexture(GC->uiLayer);
+                }
+                GC->uiLayer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+                if (GC->uiLayer == NULL) {
+                        fprintf(stderr, "UI layer error: %s\n", SDL_GetError());
+                        GC->uiLayerValid = false;
+                        return false;
+                }
+                SDL_SetTextureBlendMode(GC->uiLayer, SDL_BLENDMODE_NONE); // Opaque all over
+        }
+
+        // A target drops the logical size, scale it up by hand instead
+        if (SDL_SetRenderTarget(renderer, GC->uiLayer) != 0) {
+                fprintf(stderr, "UI layer error: %s\n", SDL_GetError());
+                GC->uiLayerValid = false;
+                return false;
+        }
+        SDL_RenderSetScale(renderer, scale, scale);
+        renderGameUI(renderer, GC);
+        SDL_SetRenderTarget(renderer, NULL);
+        GC->uiLayerKey = key;
+        GC->uiLayerValid = true;
+
+        SDL_RenderCopy(renderer, GC->uiLayer, NULL, &(SDL_Rect) { 0, 0, VIRTUAL_WIDTH, VIRTUAL_HEIGHT });
+        drawCallCount++;
+        return true;
+}
+
 void game_render(GameContext* GC) {
+        TraceZone zone = trace_begin("game_render");
+        const SimFrame* frame = GC->frame;
+        drawCallCount = 0;
+
         // Clear to BLACK
         SDL_SetRenderDrawColor(GC->renderer, 0, 0, 0, 255);
         SDL_RenderClear(GC->renderer);
-
-        // Virtual ... Background:
-        SDL_SetRenderDrawColor(GC->renderer, unpack_color(enumToColor(COLOR_BACKGROUND)));
-        SDL_Rect r = { 0, 0, VIRTUAL_WIDTH, VIRTUAL_HEIGHT };
-        SDL_RenderFillRect(GC->renderer, &r);
+        drawCallCount++;
 
         // Game UI
-        renderGameUI(GC->renderer, GC);
+        TraceZone part = trace_begin("ui");
+        if (!drawUiLayer(GC)) {
+                renderGameUI(GC->renderer, GC);
+        }
+        trace_end(part);
 
         // Game
+        part = trace_begin("particles");
         renderAllParticles(GC);
-        if (GC->gameData.gameStarted) {
-                renderTetrimino(GC->renderer, &GC->gameData.currentTetromino, false);
+        trace_end(part);
+
+        // Piece, ghost and flash in one batch
+        DrawBatch* batch = &GC->drawBatch;
+        drawbatch_begin(batch, GC->renderer);
+        TetrominoData shown = interpolatedTetromino(GC);
+        if (frame->gameStarted) {
+                renderTetrimino(batch, &shown, false);
         }
 
-        // Hide Tetrimino outOfBoundPart
-        SDL_SetRenderDrawColor(GC->renderer, unpack_color(enumToColor(COLOR_BACKGROUND)));
-        r.x = GAME_POS_X;
-        r.y = 1;
-        r.w = GAME_WIDTH;
-        r.h = GAME_POS_Y - 2;
-        SDL_RenderFillRect(GC->renderer, &r);
-
-        // Game UI: Outermost border // Cause of order of drawing on renderer
-        SDL_SetRenderDrawColor(GC->renderer, unpack_color(enumToColor(COLOR_BORDER)));
-        r = (SDL_Rect) { .x = 0, .y = 0, .w = VIRTUAL_WIDTH, .h = VIRTUAL_HEIGHT };
-        SDL_RenderDrawRect(GC->renderer, &r);
-
-        if (!GC->gameData.gameOver && GC->gameData.gameStarted) {
-                SDL_Rect rect = TetrominoBounds(&GC->gameData.currentTetromino);
+        if (!frame->gameOver && frame->gameStarted) {
+                SimRect rect = sim_tetrominoBounds(&frame->current);
                 if (rect.y >= GAME_POS_Y) {
-                        renderTetrimino(GC->renderer, &GC->gameData.ghostTetromino, true);
+                        TetrominoData ghost = frame->ghost;
+                        ghost.x = shown.x; // Follows the drawn piece sideways
+                        renderTetrimino(batch, &ghost, true);
                 }
         }
 
+        // Clear flash, fades out over the board
+        if (frame->flash >= 0.0f) {
+                SDL_Rect r = { .x = GAME_POS_X, .y = GAME_POS_Y, .w = GAME_WIDTH, .h = GAME_HEIGHT };
+                drawbatch_fill(batch, r, (SDL_Color) { 255, 255, 255, (Uint8) (96 * (1.0f - frame->flash)) });
+        }
+
+        // Hide Tetrimino outOfBoundPart: nothing of it above the play field border. The ghost and
+        // the flash are below it anyway
+        SDL_RenderSetClipRect(GC->renderer, &(SDL_Rect) { 0, GAME_POS_Y - 1, VIRTUAL_WIDTH, VIRTUAL_HEIGHT - GAME_POS_Y + 1 });
+        drawbatch_flush(batch);
+        SDL_RenderSetClipRect(GC->renderer, NULL);
+
         // GameOver Screen
-        if (GC->gameData.gameOver || GC->gameData.gameStarted == false || GC->gameData.gamePaused) {
+        if (frame->gameOver || frame->gameStarted == false || frame->gamePaused) {
+                part = trace_begin("text");
                 char str[256];
                 SDL_Rect txtContainerRect = (SDL_Rect) {
                         .x = GAME_POS_X + GAME_PADDING,
@@ -900,37 +699,52 @@ void game_render(GameContext* GC) {
                 };
                 SDL_Color color = {
                         .r = 255,
-                        .g = (GC->gameData.gameStarted == false || GC->gameData.gamePaused)? 255: 0,
+                        .g = (frame->gameStarted == false || frame->gamePaused)? 255: 0,
                         .b = 255,
                         .a = 255
                 };
 
-                snprintf(str, sizeof(str), GC->gameData.gameStarted == false? "Sand Tetris": GC->gameData.gameOver? "GAME OVER": "GAME PAUSED");
+                snprintf(str, sizeof(str), frame->gameStarted == false? "Sand Tetris": frame->gameOver? "GAME OVER": "GAME PAUSED");
                 font_render_rect(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, color, txtContainerRect);
 
-                if (GC->gameData.gameStarted) {
+                if (frame->gameStarted) {
                         txtContainerRect.h -= GAME_HEIGHT / 3;
                         txtContainerRect.y += GAME_HEIGHT / 3;
-                        snprintf(str, sizeof(str), "Your Score: %u", GC->gameData.score);
-                        font_render_rect(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, color, txtContainerRect);
+                        snprintf(str, sizeof(str), "Your Score: %u", frame->score);
+                        font_render_rect_atlas(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_NORMAL, color, txtContainerRect);
                 }
 
                 txtContainerRect.h -= GAME_PADDING * 3;
                 txtContainerRect.y += GAME_HEIGHT / 5;
-                snprintf(str, sizeof(str), GC->gameData.gameStarted == false? "Press [Enter] to play": GC->gameData.gamePaused? "Press [Escape] To Play": "Press [Enter] to play again");
+                snprintf(str, sizeof(str), frame->gameStarted == false? "Press [Enter] to play": frame->gamePaused? "Press [Escape] To Play": "Press [Enter] to play again");
                 font_render_rect(&GC->fontData, GC->renderer, str, FONT_PATH, -1, TTF_STYLE_ITALIC, color, txtContainerRect);
+                trace_end(part);
         }
 
+        GC->drawCalls = drawCallCount;
+
         // Display modified renderer
+        part = trace_begin("present");
         SDL_RenderPresent(GC->renderer);
+        trace_end(part);
+        trace_end(zone);
 }
 
 void game_cleanup(GameContext* GC) {
-        CleanUpTetriminoCollection(&GC->gameData.tetrominoCollection);
+        simthread_stop(&GC->simThread);
+        if (GC->simThread.recording) {
+                replay_save(&GC->replay, REPLAY_FILE);
+        }
+        replay_free(&GC->replay);
+        frames_free(&GC->frames);
+        sim_cleanup(&GC->gameData);
         fontData_destroy(&GC->fontData);
         audio_cleanup(&GC->audioData);
         TTF_Quit();
         SDL_FreeFormat(GC->pixelFormat);
+        if (GC->uiLayer) {
+                SDL_DestroyTexture(GC->uiLayer);
+        }
         SDL_DestroyTexture(GC->texture);
         SDL_DestroyRenderer(GC->renderer);
         SDL_DestroyWindow(GC->window);
@@ -939,169 +753,9 @@ void game_cleanup(GameContext* GC) {
         free(GC->sfxSlider);
 
         SDL_Quit();
+        trace_cleanup(); // After sim_cleanup, the sand workers are gone
 }
 
-static inline void InitializeTetriminoCollection(TetrominoCollection* TC) {
-        TC->capacity = 5; // 4 Tetriminos: | Shaped, Z Shaped, Square Shaped, L Shape
-        TC->tetrominos = malloc(sizeof(struct Tetromino) * TC->capacity);
-        TC->count = 0;
-        TC->tetrominos[TC->count++] = (struct Tetromino) {
-                .name = "Line Tetrimino", // Display Name!
-                .shape = {
-                        { // Rotation 1: rotation left of rotation 4
-                                {0, 0, 0, 0},
-                                {1, 1, 1, 1},
-                                {0, 0, 0, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 2: rotation left of rotation 1
-                                {0, 1, 0, 0},
-                                {0, 1, 0, 0},
-                                {0, 1, 0, 0},
-                                {0, 1, 0, 0},
-                        },
-                        { // Rotation 3: rotation left of rotation 2
-                                {0, 0, 0, 0},
-                                {0, 0, 0, 0},
-                                {1, 1, 1, 1},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 4: rotation left of rotation 3
-                                {0, 0, 1, 0},
-                                {0, 0, 1, 0},
-                                {0, 0, 1, 0},
-                                {0, 0, 1, 0},
-                        }
-                }
-        };
-
-        TC->tetrominos[TC->count++] = (struct Tetromino) {
-                .name = "Square Tetrimino", // Display Name!
-                .shape = {
-                        { // Rotation 1: rotation left of rotation 4
-                                {0, 0, 0, 0},
-                                {0, 1, 1, 0},
-                                {0, 1, 1, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 2: rotation left of rotation 1
-                                {0, 0, 0, 0},
-                                {0, 1, 1, 0},
-                                {0, 1, 1, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 3: rotation left of rotation 2
-                                {0, 0, 0, 0},
-                                {0, 1, 1, 0},
-                                {0, 1, 1, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 4: rotation left of rotation 3
-                                {0, 0, 0, 0},
-                                {0, 1, 1, 0},
-                                {0, 1, 1, 0},
-                                {0, 0, 0, 0},
-                        }
-                }
-        };
-
-        TC->tetrominos[TC->count++] = (struct Tetromino) {
-                .name = "Skew Tetrimino", // Display Name!
-                .shape = {
-                        { // Rotation 1: rotation left of rotation 4
-                                {0, 0, 0, 0},
-                                {0, 0, 1, 1},
-                                {0, 1, 1, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 2: rotation left of rotation 1
-                                {0, 1, 0, 0},
-                                {0, 1, 1, 0},
-                                {0, 0, 1, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 3: rotation left of rotation 2
-                                {0, 0, 0, 0},
-                                {0, 1, 1, 0},
-                                {1, 1, 0, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 4: rotation left of rotation 3
-                                {0, 0, 0, 0},
-                                {0, 1, 0, 0},
-                                {0, 1, 1, 0},
-                                {0, 0, 1, 0},
-                        }
-                }
-        };
-
-        TC->tetrominos[TC->count++] = (struct Tetromino) {
-                .name = "L Tetrimino", // Display Name!
-                .shape = {
-                        { // Rotation 1: rotation left of rotation 4
-                                {0, 0, 0, 0},
-                                {0, 1, 0, 0},
-                                {0, 1, 0, 0},
-                                {0, 1, 1, 0},
-                        },
-                        { // Rotation 2: rotation left of rotation 1
-                                {0, 0, 0, 0},
-                                {0, 0, 0, 1},
-                                {0, 1, 1, 1},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 3: rotation left of rotation 2
-                                {0, 1, 1, 0},
-                                {0, 0, 1, 0},
-                                {0, 0, 1, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 4: rotation left of rotation 3
-                                {0, 0, 0, 0},
-                                {1, 1, 1, 0},
-                                {1, 0, 0, 0},
-                                {0, 0, 0, 0},
-                        }
-                }
-        };
-
-
-        TC->tetrominos[TC->count++] = (struct Tetromino) {
-                .name = "T Tetrimino", // Display Name!
-                .shape = {
-                        { // Rotation 1: rotation left of rotation 4
-                                {0, 0, 0, 0},
-                                {0, 1, 1, 1},
-                                {0, 0, 1, 0},
-                                {0, 0, 1, 0},
-                        },
-                        { // Rotation 2: rotation left of rotation 1
-                                {0, 1, 0, 0},
-                                {0, 1, 1, 1},
-                                {0, 1, 0, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 3: rotation left of rotation 2
-                                {0, 1, 0, 0},
-                                {0, 1, 0, 0},
-                                {1, 1, 1, 0},
-                                {0, 0, 0, 0},
-                        },
-                        { // Rotation 4: rotation left of rotation 3
-                                {0, 0, 0, 0},
-                                {0, 0, 1, 0},
-                                {1, 1, 1, 0},
-                                {0, 0, 1, 0},
-                        }
-                }
-        };
-}
-
-static inline void CleanUpTetriminoCollection(TetrominoCollection* TC) {
-        if (TC->tetrominos != NULL) {
-                free(TC->tetrominos);
-        }
-}
 
 static SDL_Color enumToColor(ColorCode CC){
         SDL_Color color = {0};
@@ -1202,59 +856,3 @@ static SDL_Color enumToColor(ColorCode CC){
 
         return color;
 }
-
-static void destroyCurrentTetromino(GameData* GD) {
-        TetrominoData *TD = &GD->currentTetromino;
-        const unsigned short (*shape)[4] = TD->shape->shape[TD->rotation];
-
-        ColorCode color = TD->color;
-        int start_x = (int)TD->x - GAME_POS_X;
-        int start_y = (int)TD->y - GAME_POS_Y;
-
-
-        // Loop through 4x4 grid of current tetromino
-        for (int row = 0; row < 4; row++) {
-                for (int col = 0; col < 4; col++) {
-                        if (shape[row][col] == 0) continue;
-
-                        // Calculate base position for this block within the tetromino
-                        int block_base_x = start_x + col * PARTICLE_COUNT_IN_BLOCK_COLUMN;
-                        int block_base_y = start_y + row * PARTICLE_COUNT_IN_BLOCK_ROW;
-
-                        for (int y_offset = 0; y_offset < PARTICLE_COUNT_IN_BLOCK_ROW; y_offset++) {
-                                int grid_y = block_base_y + y_offset;
-
-                                // Check if within vertical bounds
-                                if (grid_y < 0 || grid_y >= GAME_HEIGHT) {
-                                        continue;
-                                }
-
-                                for (int x_offset = 0; x_offset < PARTICLE_COUNT_IN_BLOCK_COLUMN; x_offset++) {
-                                        int grid_x = block_base_x + x_offset;
-
-                                        // Check if within horizontal bounds
-                                        if (grid_x < 0 || grid_x >= GAME_WIDTH) {
-                                                continue;
-                                        }
-
-                                        // Place the color in the grid
-                                        GD->colorGrid[grid_y][grid_x] = color;
-                                }
-                        }
-                }
-        }
-
-        GD->currentTetromino = GD->nextTetromino;
-        GD->currentTetromino.velY = 0;
-        GD->currentTetromino.x = 0;
-        GD->currentTetromino.y = 0;
-        SDL_Rect rect = TetrominoBounds(&GD->currentTetromino);
-        GD->currentTetromino.x = GAME_POS_X + (GAME_WIDTH - rect.w) * 0.5f - rect.x;
-        GD->currentTetromino.y = GAME_POS_Y - rect.h;
-
-        // Initialize new next tetromino
-        InitializeTetriminoData(&GD->tetrominoCollection, &GD->nextTetromino);
-        rect = TetrominoBounds(&GD->nextTetromino);
-        GD->nextTetromino.x = INFO_PANEL_X + (INFO_PANEL_WIDTH - rect.w) * 0.5f - rect.x;
-        GD->nextTetromino.y = INFO_PANEL_Y + (INFO_PANEL_HEIGHT) * 0.05f;
-}
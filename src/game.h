@@ -7,39 +7,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "config.h"
+#include "drawbatch.h"
 #include "font.h"
 #include "Audio.h"
 #include "HighScore.h"
-
-typedef enum {
-        COLOR_RED = 0,
-        COLOR_GREEN,
-        COLOR_BLUE,
-        COLOR_YELLOW,
-
-        COLOR_COUNT,
-
-        COLOR_DELETE_MARKED_SAND,
-
-        COLOR_BORDER,
-        COLOR_BACKGROUND, // Background color
-        COLOR_SAND,
-
-        COLOR_NONE, // Special Type!
-} ColorCode;
-
-struct Tetromino {
-        // This is constant structure for defining the shapes of tetromino: L Shape, Square Shape, Line, Z Shape...
-        // A tetromino is a geometric shape composed of four connected squares
-        // 4 different rotation options
-        unsigned short shape[4][4][4];
-        char name[32]; // Optional?
-};
-typedef struct {
-        struct Tetromino* tetrominos;
-        size_t capacity;
-        size_t count;
-} TetrominoCollection;
+#include "simulation.h"
+#include "replay.h"
+#include "frames.h"
+#include "simthread.h"
 
 typedef struct {
         ColorCode color; // repeated in tetrominoData but who cares!
@@ -48,33 +23,19 @@ typedef struct {
         float velY; // Velocity which determines how particle behaves!
 } SandBlock;
 
+// Everything the static part of the screen is drawn from, see drawUiLayer.
+// Compared with memcmp, so it is zeroed before being filled in
 typedef struct {
-        const struct Tetromino *shape;
-        uint8_t rotation; // 0–3
-        float x, y; // position of topleft block's topleft!
-        float velY;
-        ColorCode color;
-
-        // SandBlock sandBlock[4]; // 4 Blocks in a tetrimino
-} TetrominoData;
-
-typedef struct {
-        // Data on all things needed for game to function
+        float scale; // Output pixels per virtual pixel, the layer is drawn at output resolution
         unsigned score;
-
-        int colorGrid[GAME_HEIGHT][GAME_WIDTH]; // Store color code only for all pixels on game screen (After blocks converted to sand)
-
-        TetrominoCollection tetrominoCollection; // Total Tetromino type in game collection!
-
-        TetrominoData currentTetromino;
-        TetrominoData ghostTetromino;
-        TetrominoData nextTetromino;
-
+        int highScores[HIGH_SCORE_COUNT];
+        int musicHandleX, sfxHandleX;
         bool gameStarted;
-        bool gamePaused;
-        bool gameOver;
-        bool sandRemoveTrigger;
-} GameData;
+        const struct Tetromino* nextShape;
+        int nextRotation;
+        ColorCode nextColor;
+        float nextX, nextY;
+} UiLayerKey;
 
 // Main game context
 typedef struct {
@@ -82,7 +43,13 @@ typedef struct {
         SDL_Renderer *renderer;
 
         SDL_Texture* texture;
+        SDL_Texture* uiLayer; // Background, borders and side panel, redrawn only when uiLayerKey changes
+        UiLayerKey uiLayerKey;
+        bool uiLayerValid; // False: redraw it before the next use
         SDL_PixelFormat *pixelFormat;
+        Uint32 palette[256]; // ColorCode -> texture pixel, any grid byte is a valid index. See buildPalette
+        DrawBatch drawBatch; // Pieces, borders and sliders, flushed within the function filling it
+        unsigned drawCalls; // Render calls the last game_render made, present not counted
 
         bool running;
 
@@ -95,7 +62,14 @@ typedef struct {
         const Uint8* keys;
 
         // Gamedata: gameOver? score, level, sanddata, which tetromino next?, etc
+        // Belongs to simThread while it runs, everything drawn comes from frame
         GameData gameData;
+        SimThread simThread; // Ticks gameData and publishes frames
+        SimFrames frames;
+        const SimFrame* frame; // Newest one, taken by game_update
+        bool frameIsNew; // Its rows are not on the texture yet, see renderAllParticles
+        SimRng renderRng; // Shimmer of marked sand, kept apart so drawing never changes the game
+        Replay replay; // Input of every tick since start, saved to REPLAY_FILE on exit
 
         AudioData audioData;
         AudioSlider *musicSlider;
@@ -110,6 +84,10 @@ void game_update(GameContext*);
 void game_render(GameContext*);
 void game_cleanup(GameContext*);
 
+// Render pieces, for benchmarks
+void renderAllParticles(GameContext*);
+void buildPalette(GameContext*); // Call after (re)creating pixelFormat
+
 #endif
 
 // LOGIC
@@ -1,11 +1,13 @@
 #include "game.h"
 #include "config.h"
+#include "trace.h"
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 #include <stdio.h>
 
 int main(void) {
         GameContext GC;
+        trace_setThreadName("main");
         if (!game_init(&GC)) {
                 return 1;
         }
@@ -19,9 +21,11 @@ int main(void) {
                 GC.last_time = current_time;
                 GC.delta_time = frame_time / 1000.0f; // Convert to seconds
 
+                TraceZone frame = trace_begin("frame");
                 game_handle_events(&GC);
                 game_update(&GC);
                 game_render(&GC);
+                trace_end(frame);
 
                 // Frame limiting
                 Uint32 render_time = SDL_GetTicks() - current_time;
@@ -35,7 +39,7 @@ int main(void) {
 
                         frame_count++;
                         if (current_time - fps_timer >= 1000) {
-                                printf("FPS: %d, Delta: %.3fms, Score: %d\n", frame_count, GC.delta_time * 1000.0f, GC.gameData.score);
+                                printf("FPS: %d, Delta: %.3fms, Draw calls: %u, Score: %d\n", frame_count, GC.delta_time * 1000.0f, GC.drawCalls, GC.frame->score);
                                 fflush(stdout);
 
                                 frame_count = 0;
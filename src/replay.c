@@ -0,0 +1,194 @@
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void replay_init(Replay* R, SimConfig config, uint64_t seed, SimStepper stepper) {
+        R->config = config;
+        R->seed = seed;
+        R->stepper = stepper;
+        R->tickRate = SIM_TICK_RATE;
+        R->ticks = 0;
+        R->runs = NULL;
+        R->runCount = 0;
+        R->runCapacity = 0;
+}
+
+// Room for one more run, doubling like any growing array
+static bool reserveRun(Replay* R) {
+        if (R->runCount < R->runCapacity) {
+                return true;
+        }
+        int capacity = R->runCapacity? R->runCapacity * 2: 256;
+        ReplayRun* runs = realloc(R->runs, sizeof(ReplayRun) * capacity);
+        if (runs == NULL) {
+                return false;
+        }
+        R->runs = runs;
+        R->runCapacity = capacity;
+        return true;
+}
+
+bool replay_record(Replay* R, SimInput input) {
+        if (R->runCount > 0) {
+                ReplayRun* last = &R->runs[R->runCount - 1];
+                if (last->input == input && last->length < UINT32_MAX) {
+                        last->length++;
+                        R->ticks++;
+                        return true;
+                }
+        }
+
+        if (!reserveRun(R)) {
+                fprintf(stderr, "Replay: out of memory after %ld ticks\n", R->ticks);
+                return false;
+        }
+
+        R->runs[R->runCount++] = (ReplayRun) { .input = (uint8_t) input, .length = 1 };
+        R->ticks++;
+        return true;
+}
+
+void replay_free(Replay* R) {
+        free(R->runs);
+        R->runs = NULL;
+        R->runCount = 0;
+        R->runCapacity = 0;
+        R->ticks = 0;
+}
+
+// Little endian no matter the machine
+static void putUint(FILE* file, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+                fputc((int) (value >> (8 * i)) & 0xFF, file);
+        }
+}
+
+static bool getUint(FILE* file, uint64_t* value, int bytes) {
+        *value = 0;
+        for (int i = 0; i < bytes; i++) {
+                int c = fgetc(file);
+                if (c == EOF) return false;
+                *value |= (uint64_t) c << (8 * i);
+        }
+        return true;
+}
+
+// 7 bits per byte, high bit set while more follow. Most runs fit in one or two bytes
+static void putVarint(FILE* file, uint32_t value) {
+        while (value >= 0x80) {
+                fputc((int) (value & 0x7F) | 0x80, file);
+                value >>= 7;
+        }
+        fputc((int) value, file);
+}
+
+static bool getVarint(FILE* file, uint32_t* value) {
+        *value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+                int c = fgetc(file);
+                if (c == EOF) return false;
+                *value |= (uint32_t) (c & 0x7F) << shift;
+                if ((c & 0x80) == 0) return true;
+        }
+        return false;
+}
+
+bool replay_save(const Replay* R, const char* path) {
+        FILE* file = fopen(path, "wb");
+        if (file == NULL) {
+                fprintf(stderr, "Replay: could not write %s\n", path);
+                return false;
+        }
+
+        fwrite(REPLAY_MAGIC, 1, 4, file);
+        putUint(file, REPLAY_VERSION, 2);
+        putUint(file, R->stepper, 1);
+        putUint(file, 0, 1);
+        putUint(file, R->tickRate, 2);
+        putUint(file, R->config.width, 2);
+        putUint(file, R->config.height, 2);
+        putUint(file, R->seed, 8);
+        putUint(file, R->ticks, 4);
+        putUint(file, R->runCount, 4);
+        for (int i = 0; i < R->runCount; i++) {
+                putUint(file, R->runs[i].input, 1);
+                putVarint(file, R->runs[i].length);
+        }
+
+        bool ok = !ferror(file);
+        if (fclose(file) != 0) ok = false;
+        if (!ok) {
+                fprintf(stderr, "Replay: error while writing %s\n", path);
+        }
+        return ok;
+}
+
+bool replay_load(Replay* R, const char* path) {
+        replay_free(R);
+
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+                fprintf(stderr, "Replay: could not open %s\n", path);
+                return false;
+        }
+
+        char magic[4];
+        uint64_t version, stepper, unused, tickRate, width, height, seed, ticks, runCount;
+        bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, REPLAY_MAGIC, 4) == 0
+                && getUint(file, &version, 2) && getUint(file, &stepper, 1) && getUint(file, &unused, 1)
+                && getUint(file, &tickRate, 2) && getUint(file, &width, 2) && getUint(file, &height, 2)
+                && getUint(file, &seed, 8) && getUint(file, &ticks, 4) && getUint(file, &runCount, 4);
+        if (!ok || version != REPLAY_VERSION) {
+                fprintf(stderr, "Replay: %s is not a version %d replay\n", path, REPLAY_VERSION);
+                fclose(file);
+                return false;
+        }
+        if (width > SIM_MAX_SIZE || height > SIM_MAX_SIZE || tickRate == 0 || stepper > SIM_STEPPER_STRIPES) {
+                fprintf(stderr, "Replay: %s was recorded on a %dx%d grid at %d ticks/s, can't play that\n",
+                        path, (int) width, (int) height, (int) tickRate);
+                fclose(file);
+                return false;
+        }
+
+        // Every run is at least one tick and two bytes (input, length), more than that is a broken header
+        long start = ftell(file), end = -1;
+        if (start >= 0 && fseek(file, 0, SEEK_END) == 0) {
+                end = ftell(file);
+        }
+        if (end < 0 || fseek(file, start, SEEK_SET) != 0 || runCount > ticks || runCount > (uint64_t) (end - start) / 2) {
+                fprintf(stderr, "Replay: %s is truncated\n", path);
+                fclose(file);
+                return false;
+        }
+
+        // Grown as the runs are read, the header's count is only trusted once they're all there
+        replay_init(R, (SimConfig) { .width = (int) width, .height = (int) height }, seed, (SimStepper) stepper);
+        R->tickRate = (int) tickRate;
+        for (uint64_t i = 0; i < runCount; i++) {
+                uint64_t input;
+                uint32_t length;
+                if (!getUint(file, &input, 1) || !getVarint(file, &length) || length == 0) {
+                        fprintf(stderr, "Replay: %s is truncated\n", path);
+                        fclose(file);
+                        replay_free(R);
+                        return false;
+                }
+                if (!reserveRun(R)) {
+                        fprintf(stderr, "Replay: out of memory loading %s\n", path);
+                        fclose(file);
+                        replay_free(R);
+                        return false;
+                }
+                R->runs[R->runCount++] = (ReplayRun) { .input = (uint8_t) input, .length = length };
+                R->ticks += length;
+        }
+        fclose(file);
+
+        if (R->ticks != (long) ticks) {
+                fprintf(stderr, "Replay: %s says %ld ticks but holds %ld\n", path, (long) ticks, R->ticks);
+                replay_free(R);
+                return false;
+        }
+        return true;
+}
@@ -0,0 +1,42 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// Recorded games: grid size, seed and the input of every tick. Playing the inputs back through
+// sim_step on a fresh sim_init(config, seed) gives the exact same game, see tools/playback.c
+//
+// File layout, little endian:
+//   "STRP", u16 version, u8 stepper, u8 unused, u16 tick rate, u16 grid width, u16 grid height,
+//   u64 seed, u32 ticks, u32 runs, then per run: u8 input and its length in ticks as a varint
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "simulation.h"
+
+#define REPLAY_MAGIC "STRP"
+#define REPLAY_VERSION 2 // 2: no second sand move at stripe edges, older games play out differently
+
+// Same input for length ticks in a row, held keys and idle time collapse into a few of these
+typedef struct {
+        uint8_t input;
+        uint32_t length;
+} ReplayRun;
+
+typedef struct {
+        SimConfig config; // What sim_init got
+        uint64_t seed;
+        SimStepper stepper; // Only informative, every stepper and thread count rolls the same sand
+        int tickRate;
+        long ticks;
+
+        ReplayRun* runs;
+        int runCount;
+        int runCapacity;
+} Replay;
+
+void replay_init(Replay*, SimConfig config, uint64_t seed, SimStepper stepper);
+bool replay_record(Replay*, SimInput input); // Call once per tick with what sim_step got
+bool replay_save(const Replay*, const char* path);
+bool replay_load(Replay*, const char* path); // Replaces whatever was in there
+void replay_free(Replay*);
+
+#endif
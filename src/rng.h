@@ -0,0 +1,68 @@
+#ifndef RNG_H
+#define RNG_H
+
+// Small seedable random generator (xoshiro256**), one per user: the simulation, each sand
+// stripe, the renderer. Nothing shared, no locks, same sequence for the same seed everywhere.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+        uint64_t s[4];
+        uint64_t bits; // Unused coin flips from the last draw, see rng_bit
+        int bitsLeft;
+} SimRng;
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+}
+
+// splitmix64 spreads any seed (0 too) over the whole state
+static inline void rng_seed(SimRng* rng, uint64_t seed) {
+        for (int i = 0; i < 4; i++) {
+                uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                rng->s[i] = z ^ (z >> 31);
+        }
+        rng->bits = 0;
+        rng->bitsLeft = 0;
+}
+
+static inline uint64_t rng_next(SimRng* rng) {
+        uint64_t* s = rng->s;
+        uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rng_rotl(s[3], 45);
+        return result;
+}
+
+// Uniform in [0, n), multiply-shift instead of modulo
+static inline uint32_t rng_below(SimRng* rng, uint32_t n) {
+        return (uint32_t) (((rng_next(rng) >> 32) * n) >> 32);
+}
+
+// One coin flip, 64 of them per draw
+static inline bool rng_bit(SimRng* rng) {
+        if (rng->bitsLeft == 0) {
+                rng->bits = rng_next(rng);
+                rng->bitsLeft = 64;
+        }
+        bool bit = rng->bits & 1;
+        rng->bits >>= 1;
+        rng->bitsLeft--;
+        return bit;
+}
+
+// Independent stream for a worker: seeded from this one
+static inline void rng_split(SimRng* rng, SimRng* out) {
+        rng_seed(out, rng_next(rng));
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include "simthread.h"
+#include "config.h"
+#include "trace.h"
+#include <stdio.h>
+
+// Same pacing the frame loop had: a tick is due every SIM_TICK_SECONDS, at most
+// SIM_MAX_TICKS_PER_FRAME get caught up at once and an older backlog is dropped
+static int simThreadMain(void* arg) {
+        SimThread* ST = arg;
+        GameData* GD = ST->GD;
+        trace_setThreadName("sim");
+
+        const Uint64 frequency = SDL_GetPerformanceFrequency();
+        const Uint64 tickLength = frequency / SIM_TICK_RATE;
+        Uint64 due = SDL_GetPerformanceCounter() + tickLength;
+
+        while (!atomic_load_explicit(&ST->quit, memory_order_relaxed)) {
+                Uint64 now = SDL_GetPerformanceCounter();
+                TetrominoData previous = GD->currentTetromino;
+                SimEvents events = SIM_EVENT_NONE;
+                Uint64 lastTick = 0; // When the newest tick simulated here was due, what the frame blends from
+                int ticks = 0;
+                while (now >= due && ticks < SIM_MAX_TICKS_PER_FRAME) {
+                        if (atomic_exchange(&ST->forceGameOver, false)) {
+                                GD->score = 10000;
+                                GD->gameOver = true;
+                                ST->recording = false; // Not an input, can't be replayed
+                                events |= SIM_EVENT_GAME_OVER;
+                        }
+
+                        // Presses go in with the first tick that sees them, held directions with every one
+                        SimInput input = atomic_load(&ST->held) | atomic_exchange(&ST->pressed, SIM_INPUT_NONE);
+                        previous = GD->currentTetromino;
+                        if (ST->recording && !replay_record(ST->replay, input)) {
+                                ST->recording = false;
+                        }
+                        TraceZone zone = trace_begin("sim_step");
+                        SimEvents tickEvents = sim_step(GD, input, SIM_TICK_SECONDS);
+                        trace_end(zone);
+                        if (tickEvents & (SIM_EVENT_STARTED | SIM_EVENT_PIECE_LOCKED)) {
+                                previous = GD->currentTetromino; // New piece, nothing to blend from
+                        }
+                        events |= tickEvents;
+
+                        lastTick = due;
+                        due += tickLength;
+                        ticks++;
+                }
+                if (now >= due) {
+                        due = now - (now - due) % tickLength + tickLength; // Over budget: drop the backlog
+                }
+
+                if (ticks > 0) {
+                        TraceZone zone = trace_begin("publish frame");
+                        frames_publish(ST->frames, GD, &previous, lastTick); // Not due - tickLength, dropping the backlog moves due
+                        trace_end(zone);
+                        if (events) {
+                                atomic_fetch_or(&ST->events, events); // After the frame, see simthread_takeEvents
+                        }
+                }
+
+                // SDL_Delay is in whole ms: sleep at least one, a little late is fine, the next round catches up
+                now = SDL_GetPerformanceCounter();
+                if (due > now) {
+                        Uint32 ms = (Uint32) ((due - now) * 1000 / frequency);
+                        SDL_Delay(ms > 0? ms: 1);
+                }
+        }
+        return 0;
+}
+
+bool simthread_start(SimThread* ST, GameData* GD, Replay* replay, SimFrames* frames) {
+        ST->GD = GD;
+        ST->replay = replay;
+        ST->frames = frames;
+        ST->recording = true;
+        atomic_init(&ST->pressed, SIM_INPUT_NONE);
+        atomic_init(&ST->held, SIM_INPUT_NONE);
+        atomic_init(&ST->events, SIM_EVENT_NONE);
+        atomic_init(&ST->forceGameOver, false);
+        atomic_init(&ST->quit, false);
+
+        ST->thread = SDL_CreateThread(simThreadMain, "sim", ST);
+        if (ST->thread == NULL) {
+                fprintf(stderr, "Sim thread error: %s\n", SDL_GetError());
+                return false;
+        }
+        return true;
+}
+
+void simthread_press(SimThread* ST, SimInput input) {
+        atomic_fetch_or(&ST->pressed, input);
+}
+
+void simthread_hold(SimThread* ST, SimInput input) {
+        atomic_store(&ST->held, input);
+}
+
+SimEvents simthread_takeEvents(SimThread* ST) {
+        return atomic_exchange(&ST->events, SIM_EVENT_NONE);
+}
+
+void simthread_forceGameOver(SimThread* ST) {
+        atomic_store(&ST->forceGameOver, true);
+}
+
+void simthread_stop(SimThread* ST) {
+        if (ST->thread == NULL) {
+                return;
+        }
+        atomic_store(&ST->quit, true);
+        SDL_WaitThread(ST->thread, NULL);
+        ST->thread = NULL;
+}
@@ -0,0 +1,40 @@
+#ifndef SIMTHREAD_H
+#define SIMTHREAD_H
+
+// The game's simulation on a thread of its own. It runs the fixed ticks on its own clock and
+// publishes a frame after them (see frames.h), the main thread handles events and draws the
+// newest frame. A slow present no longer holds up the sand, a heavy sand step no longer holds up drawing.
+
+#include <SDL2/SDL.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "frames.h"
+#include "replay.h"
+#include "simulation.h"
+
+typedef struct {
+        SDL_Thread* thread;
+        GameData* GD; // The thread's alone while it runs
+        Replay* replay; // Input of every tick
+        SimFrames* frames;
+        bool recording; // Off once recording failed, a replay with holes is worse than none. Read after simthread_stop
+
+        atomic_uint pressed; // One-shot presses, go in with the next tick
+        atomic_uint held; // Held directions, go in with every tick
+        atomic_uint events; // SimEvents since the last simthread_takeEvents
+        atomic_bool forceGameOver; // DEBUG shortcut, not an input so it ends the recording
+        atomic_bool quit;
+} SimThread;
+
+// GD has to be set up and frames published from it already. False when the thread can't start
+bool simthread_start(SimThread*, GameData* GD, Replay* replay, SimFrames* frames);
+void simthread_press(SimThread*, SimInput);
+// Replaces the held directions, call every frame with what is down now
+void simthread_hold(SimThread*, SimInput);
+// Published before the frame showing them, so take events first, then the frame
+SimEvents simthread_takeEvents(SimThread*);
+void simthread_forceGameOver(SimThread*);
+// Waits for the tick in progress, the GameData is the caller's again afterwards
+void simthread_stop(SimThread*);
+
+#endif
@@ -0,0 +1,1807 @@
+#include "simulation.h"
+#include "config.h"
+#include "trace.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define randColor(rng) rng_below(rng, COLOR_COUNT)
+#define randRotation(rng) rng_below(rng, 4) // 4 rotations total so MAGIC NUMBER
+#define SIM_CLAMP(x, lo, hi) (((x) < (lo))? (lo): ((x) > (hi))? (hi): (x))
+
+// Grid dimensions as the hot loops see them. Kernels take it by value and are always inlined, so
+// the copies made for SIM_KERNEL_SIZES get constants and fold them like compile time sizes would
+// Two ints so it travels in one register when a kernel isn't inlined, the rest is derived from them
+typedef struct {
+        int width, height;
+} GridShape;
+
+#define GRID_SHAPE(w, h) ((GridShape) { (w), (h) })
+#define SHAPE_ROW_WORDS(G) GRID_ROW_WORDS((G).width)
+#define SHAPE_CHUNKS_X(G) CHUNK_COUNT((G).width)
+#define SHAPE_CHUNKS_Y(G) CHUNK_COUNT((G).height)
+#define SIM_KERNEL static inline __attribute__((always_inline))
+
+static inline GridShape gridShape(const GameData* GD) {
+        return GRID_SHAPE(GD->config.width, GD->config.height);
+}
+
+static inline uint8_t* cellRow(const GameData* GD, GridShape G, int y) {
+        return GD->colorGrid + (size_t) y * G.width;
+}
+
+static inline uint64_t* occupancyRow(const GameData* GD, GridShape G, int y) {
+        return GD->occupancy + (size_t) y * SHAPE_ROW_WORDS(G);
+}
+
+static inline SandChunk* chunkRow(const GameData* GD, GridShape G, int cy) {
+        return GD->chunks + (size_t) cy * SHAPE_CHUNKS_X(G);
+}
+
+// One time Function
+static inline void InitializeTetriminoCollection(TetrominoCollection* TC);
+static inline void CleanUpTetriminoCollection(TetrominoCollection* TC);
+static void buildCollisionRows(struct Tetromino* T);
+
+static void destroyCurrentTetromino(GameData* GD);
+static unsigned removeMarkedSand(GameData* GD);
+static const struct SandKernels* findKernels(int width, int height);
+static void buildPlane(const GameData* GD, uint64_t* plane, int value, bool invert, int y0, int y1);
+
+// This function called to create new tetrimino
+// For currentTetrimino once in init
+// For every nextTetrimino determination
+static void InitializeTetriminoData(SimRng* rng, TetrominoCollection* TC, TetrominoData* TD) {
+        TD->shape = &TC->tetrominos[rng_below(rng, TC->count)]; // Chosing 1 of random tetrimino from the collection
+
+        TD->color = randColor(rng);
+        TD->rotation = randRotation(rng);
+
+        TD->velY = GRAVITY;
+
+        TD->x = 0;
+        TD->y = 0;
+}
+
+// Clearance bookkeeping: how many cells of each color sit in each column.
+// A region can only touch both walls if its color shows up in every column, and only
+// a color that gained cells since the last check can have formed a new spanning region
+// (removing cells only ever splits regions). Every grid write goes through here.
+static inline void countCell(GameData* GD, int color, int x, int delta) {
+        if (color >= COLOR_COUNT) {
+                return;
+        }
+
+        uint16_t* count = &GD->colorColumnCount[color][x];
+        if (delta > 0) {
+                if ((*count)++ == 0) GD->colorColumnsCovered[color]++;
+                GD->clearanceDirtyColors |= 1u << color;
+        } else {
+                if (--(*count) == 0) GD->colorColumnsCovered[color]--;
+        }
+}
+
+// Chunk wake up rules, all a sand step needs to stay exact while skipping settled cells:
+//  - a grain that arrives somewhere may keep falling: visit that cell next step
+//  - a cell that empties lets the three grains above it move: visit those, this step if
+//    the sand step is running (their row comes later) and next step otherwise
+static const ChunkRect EMPTY_CHUNK_RECT = { INT16_MAX, INT16_MAX, -1, -1 };
+
+static inline void extendRect(ChunkRect* r, int x0, int x1, int y) {
+        if (x0 < r->x0) r->x0 = x0;
+        if (x1 > r->x1) r->x1 = x1;
+        if (y < r->y0) r->y0 = y;
+        if (y > r->y1) r->y1 = y;
+}
+
+static inline void markDirtyRow(GameData* GD, GridShape G, int y, int x0, int x1, bool thisStep) {
+        if (x0 < 0) x0 = 0;
+        if (x1 > G.width - 1) x1 = G.width - 1;
+        if (y < 0 || x0 > x1) {
+                return;
+        }
+
+        SandChunk* row = chunkRow(GD, G, y / CHUNK_SIZE);
+        for (int cx = x0 / CHUNK_SIZE; cx <= x1 / CHUNK_SIZE; cx++) {
+                SandChunk* chunk = &row[cx];
+                int cx0 = SIM_CLAMP(x0, cx * CHUNK_SIZE, cx * CHUNK_SIZE + CHUNK_SIZE - 1);
+                int cx1 = SIM_CLAMP(x1, cx * CHUNK_SIZE, cx * CHUNK_SIZE + CHUNK_SIZE - 1);
+                if (thisStep) {
+                        extendRect(&chunk->dirty, cx0, cx1, y);
+                        chunk->awake = true;
+                } else {
+                        extendRect(&chunk->nextDirty, cx0, cx1, y);
+                }
+        }
+}
+
+// markDirtyRow for every set bit of a row mask, for the next step. Each chunk gets the span of its
+// bits, the same rect as marking them one by one. Chunks are 16 wide so they never straddle words
+static inline void markDirtyBits(GameData* GD, GridShape G, int y, const uint64_t* bits) {
+        if (y < 0) {
+                return;
+        }
+
+        SandChunk* row = chunkRow(GD, G, y / CHUNK_SIZE);
+        for (int cx = 0; cx < SHAPE_CHUNKS_X(G); cx++) {
+                unsigned slice = (bits[GRID_BIT_WORD(cx * CHUNK_SIZE)] >> ((cx * CHUNK_SIZE) & 63)) & ((1u << CHUNK_SIZE) - 1);
+                if (slice) {
+                        int x0 = cx * CHUNK_SIZE + __builtin_ctz(slice);
+                        int x1 = cx * CHUNK_SIZE + 31 - __builtin_clz(slice);
+                        extendRect(&row[cx].nextDirty, x0, x1, y);
+                }
+        }
+}
+
+// Column height map. A cell that fills can only raise the top, one that empties only matters
+// when it was the top: then the next one down is searched, usually right below
+static inline void columnFilled(GameData* GD, int y, int x) {
+        if (y < GD->columnTop[x]) {
+                GD->columnTop[x] = y;
+        }
+}
+
+static inline void columnEmptied(GameData* GD, GridShape G, int y, int x) {
+        if (y != GD->columnTop[x]) {
+                return;
+        }
+        int top = y + 1;
+        while (top < G.height && cellRow(GD, G, top)[x] == COLOR_NONE) {
+                top++;
+        }
+        GD->columnTop[x] = top;
+}
+
+static inline void setCell(GameData* GD, int y, int x, int color) {
+        GridShape G = gridShape(GD);
+        uint8_t* cell = &cellRow(GD, G, y)[x];
+        int old = *cell;
+        if (old == color) {
+                return;
+        }
+
+        countCell(GD, old, x, -1);
+        countCell(GD, color, x, +1);
+        *cell = color;
+        int marked = (color == COLOR_DELETE_MARKED_SAND) - (old == COLOR_DELETE_MARKED_SAND);
+        GD->markedSandCount += marked;
+        GD->markedInRow[y] += marked;
+        GD->dirtyRows[y >> 6] |= 1ull << (y & 63);
+
+        // Never called from inside the sand step, so wake ups are for the next one
+        if (color == COLOR_NONE) {
+                occupancyRow(GD, G, y)[GRID_BIT_WORD(x)] &= ~GRID_BIT_MASK(x);
+                columnEmptied(GD, G, y, x);
+                markDirtyRow(GD, G, y - 1, x - 1, x + 1, false);
+        } else {
+                occupancyRow(GD, G, y)[GRID_BIT_WORD(x)] |= GRID_BIT_MASK(x);
+                columnFilled(GD, y, x);
+                markDirtyRow(GD, G, y, x, x, false);
+        }
+}
+
+// State of one sand step over a range of columns. Writes that other stripes could be doing
+// at the same time are collected here and folded into GameData once the step is over
+typedef struct SandStepper {
+        GameData* GD;
+        int x0, x1; // Columns this stepper owns
+        bool neighboursLater; // Columns past x0/x1 are still to be stepped this step
+        bool concurrent; // Other stripes run at the same time: occupancy words are shared
+        SimRng* rng; // Random stream of this stepper, never shared between threads
+        int coveredDelta[COLOR_COUNT];
+        unsigned dirtyColors;
+        uint64_t* dirtyRows; // DIRTY_ROW_WORDS(height), own part of gridMemory
+
+        // Grains a neighbour pushed into column x0 / x1 before this stripe ran, by row. They had
+        // their move this step already. Own part of gridMemory, cleared once the stripe is done
+        uint8_t* arrivedLeft;
+        uint8_t* arrivedRight;
+        uint8_t* pushLeft; // The left neighbour's arrivedRight when it still has to run, else NULL
+        uint8_t* pushRight; // The right neighbour's arrivedLeft, same
+} SandStepper;
+
+static inline void stepperDirtyRows(SandStepper* S, int y) {
+        // y and y + 1, which can straddle a word
+        S->dirtyRows[y >> 6] |= 1ull << (y & 63);
+        S->dirtyRows[(y + 1) >> 6] |= 1ull << ((y + 1) & 63);
+}
+
+static inline int stepperCoinFlip(SandStepper* S) {
+        return rng_bit(S->rng);
+}
+
+static inline void stepperSetBit(SandStepper* S, uint64_t* word, uint64_t mask) {
+        if (S->concurrent) {
+                __atomic_fetch_or(word, mask, __ATOMIC_RELAXED);
+        } else {
+                *word |= mask;
+        }
+}
+
+static inline void stepperClearBit(SandStepper* S, uint64_t* word, uint64_t mask) {
+        if (S->concurrent) {
+                __atomic_fetch_and(word, ~mask, __ATOMIC_RELAXED);
+        } else {
+                *word &= ~mask;
+        }
+}
+
+// Cells x0..x1 of row y emptied: wake the grains above them.
+// Grains above in a neighbour stripe that already ran have to wait for the next step
+static inline void wakeAbove(SandStepper* S, GridShape G, int y, int x0, int x1) {
+        x0--;
+        x1++;
+        if (x0 < S->x0) {
+                markDirtyRow(S->GD, G, y - 1, x0, x0, S->neighboursLater);
+                x0++;
+        }
+        if (x1 > S->x1) {
+                markDirtyRow(S->GD, G, y - 1, x1, x1, S->neighboursLater);
+                x1--;
+        }
+        markDirtyRow(S->GD, G, y - 1, x0, x1, true);
+}
+
+// Sand grain moving into an empty cell, only called from the sand step
+static inline void moveSand(SandStepper* S, GridShape G, int y, int x, int toY, int toX) {
+        GameData* GD = S->GD;
+        int color = cellRow(GD, G, y)[x];
+        cellRow(GD, G, toY)[toX] = color;
+        cellRow(GD, G, y)[x] = COLOR_NONE;
+        stepperSetBit(S, &occupancyRow(GD, G, toY)[GRID_BIT_WORD(toX)], GRID_BIT_MASK(toX));
+        stepperClearBit(S, &occupancyRow(GD, G, y)[GRID_BIT_WORD(x)], GRID_BIT_MASK(x));
+        columnFilled(GD, toY, toX); // Same columns as colorColumnCount below, never shared between stripes
+        columnEmptied(GD, G, y, x);
+
+        markDirtyRow(GD, G, toY, toX, toX, false);
+        wakeAbove(S, G, y, x, x);
+        stepperDirtyRows(S, y);
+        if (toX < S->x0) {
+                if (S->pushLeft) S->pushLeft[toY] = 1;
+        } else if (toX > S->x1) {
+                if (S->pushRight) S->pushRight[toY] = 1;
+        }
+
+        if (color >= COLOR_COUNT) {
+                return;
+        }
+        if (toX != x) {
+                // Columns belong to this stripe or its neighbours, only the totals are shared
+                if (--GD->colorColumnCount[color][x] == 0) S->coveredDelta[color]--;
+                if (GD->colorColumnCount[color][toX]++ == 0) S->coveredDelta[color]++;
+        }
+        S->dirtyColors |= 1u << color;
+}
+
+static void stepperFinish(GameData* GD, const SandStepper* S) {
+        for (int color = 0; color < COLOR_COUNT; color++) {
+                GD->colorColumnsCovered[color] += S->coveredDelta[color];
+        }
+        GD->clearanceDirtyColors |= S->dirtyColors;
+        for (int w = 0; w < DIRTY_ROW_WORDS(GD->config.height); w++) {
+                GD->dirtyRows[w] |= S->dirtyRows[w];
+        }
+}
+
+// Packs one bit per cell of rows [y0, y1) into a plane laid out like occupancy: bit set where (cell == value) != invert.
+// 16 cells per compare with SSE2, plain loop otherwise and for the row tail.
+SIM_KERNEL void buildPlaneShaped(const GameData* GD, GridShape G, uint64_t* plane, int value, bool invert, int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+                const uint8_t* row = cellRow(GD, G, y);
+                uint64_t* out = plane + (size_t) y * SHAPE_ROW_WORDS(G);
+                memset(out, 0, sizeof(uint64_t) * SHAPE_ROW_WORDS(G));
+
+                int x = 0;
+#if defined(__SSE2__)
+                const __m128i match = _mm_set1_epi8((char) value);
+                for (; x + 16 <= G.width; x += 16) {
+                        __m128i cells = _mm_loadu_si128((const __m128i*) (row + x));
+                        uint64_t bits = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(cells, match));
+                        if (invert) bits ^= 0xFFFF;
+                        out[GRID_BIT_WORD(x)] |= bits << (x & 63); // x is a multiple of 16, never straddles words
+                }
+#endif
+                for (; x < G.width; x++) {
+                        if ((row[x] == value) != invert) {
+                                out[GRID_BIT_WORD(x)] |= GRID_BIT_MASK(x);
+                        }
+                }
+        }
+}
+
+static inline bool rowEmpty(const uint64_t* row, int rowWords) {
+        uint64_t any = 0;
+        for (int w = 0; w < rowWords; w++) {
+                any |= row[w];
+        }
+        return any == 0;
+}
+
+// Every chunk visits all of its cells next step (awake) or none (asleep)
+static void wakeAllChunks(GameData* GD, bool awake) {
+        GridShape G = gridShape(GD);
+        for (int cy = 0; cy < SHAPE_CHUNKS_Y(G); cy++) {
+                for (int cx = 0; cx < SHAPE_CHUNKS_X(G); cx++) {
+                        SandChunk* chunk = &chunkRow(GD, G, cy)[cx];
+                        chunk->awake = false;
+                        chunk->dirty = EMPTY_CHUNK_RECT;
+                        chunk->nextDirty = EMPTY_CHUNK_RECT;
+                        if (awake) {
+                                chunk->nextDirty = (ChunkRect) {
+                                        .x0 = cx * CHUNK_SIZE,
+                                        .y0 = cy * CHUNK_SIZE,
+                                        .x1 = SIM_CLAMP(cx * CHUNK_SIZE + CHUNK_SIZE - 1, 0, G.width - 1),
+                                        .y1 = SIM_CLAMP(cy * CHUNK_SIZE + CHUNK_SIZE - 1, 0, G.height - 1),
+                                };
+                        }
+                }
+        }
+        GD->awakeChunks = 0;
+}
+
+SimConfig sim_defaultConfig(void) {
+        return (SimConfig) { .width = GAME_WIDTH, .height = GAME_HEIGHT };
+}
+
+bool sim_parseConfig(const char* text, SimConfig* config) {
+        int width, height;
+        char end;
+        if (sscanf(text, "%dx%d%c", &width, &height, &end) != 2) {
+                return false;
+        }
+        *config = (SimConfig) { .width = width, .height = height };
+        return true;
+}
+
+// Hands out the grid sized arrays one after another, each starting on a cache line.
+// Run once with no base to get the size, then again over the real block
+typedef struct {
+        uint8_t* base;
+        size_t used;
+} GridArena;
+
+static void* carve(GridArena* A, size_t bytes) {
+        void* at = A->base? A->base + A->used: NULL;
+        A->used += (bytes + 63) & ~(size_t) 63;
+        return at;
+}
+
+static void carveGrid(GameData* GD, GridArena* A) {
+        size_t cells = (size_t) GD->config.width * GD->config.height;
+        size_t planeWords = (size_t) GD->config.height * GD->rowWords;
+
+        GD->colorGrid = carve(A, cells);
+        GD->occupancy = carve(A, sizeof(uint64_t) * planeWords);
+        for (int color = 0; color < COLOR_COUNT; color++) {
+                GD->colorPlanes[color] = carve(A, sizeof(uint64_t) * planeWords);
+                GD->colorColumnCount[color] = carve(A, sizeof(uint16_t) * GD->config.width);
+        }
+        GD->columnTop = carve(A, sizeof(int16_t) * GD->config.width);
+        GD->removedPlane = carve(A, sizeof(uint64_t) * planeWords);
+        GD->runs = carve(A, sizeof(SandRun) * cells); // Worst case: every cell is its own run
+        GD->chunks = carve(A, sizeof(SandChunk) * GD->chunksX * GD->chunksY);
+        GD->markedInRow = carve(A, sizeof(uint16_t) * GD->config.height);
+        GD->dirtyRows = carve(A, sizeof(uint64_t) * DIRTY_ROW_WORDS(GD->config.height));
+        GD->stripeRng = carve(A, sizeof(SimRng) * GD->stripes);
+        GD->steppers = carve(A, sizeof(SandStepper) * GD->stripes);
+        for (int stripe = 0; stripe < GD->stripes; stripe++) {
+                uint64_t* dirtyRows = carve(A, sizeof(uint64_t) * DIRTY_ROW_WORDS(GD->config.height));
+                uint8_t* arrived = carve(A, 2 * (size_t) GD->config.height); // Left edge rows, then right edge rows
+                if (A->base) {
+                        GD->steppers[stripe].dirtyRows = dirtyRows;
+                        GD->steppers[stripe].arrivedLeft = arrived;
+                        GD->steppers[stripe].arrivedRight = arrived + GD->config.height;
+                        memset(arrived, 0, 2 * (size_t) GD->config.height);
+                }
+        }
+}
+
+bool sim_init(GameData* GD, SimConfig config, uint64_t seed) {
+        GD->pool = NULL;
+        GD->gridMemory = NULL;
+        GD->tetrominoCollection.tetrominos = NULL;
+
+        if (config.width < SIM_MIN_WIDTH || config.height < SIM_MIN_HEIGHT || config.width > SIM_MAX_SIZE || config.height > SIM_MAX_SIZE) {
+                fprintf(stderr, "Grid size %dx%d not supported, %dx%d to %dx%d\n",
+                        config.width, config.height, SIM_MIN_WIDTH, SIM_MIN_HEIGHT, SIM_MAX_SIZE, SIM_MAX_SIZE);
+                return false;
+        }
+        GD->config = config;
+        GD->rowWords = GRID_ROW_WORDS(config.width);
+        GD->chunksX = CHUNK_COUNT(config.width);
+        GD->chunksY = CHUNK_COUNT(config.height);
+        GD->stripes = SAND_STRIPE_COUNT(config.width);
+        GD->kernels = findKernels(config.width, config.height);
+        GD->sizedKernels = true;
+
+        GridArena arena = { .base = NULL, .used = 0 };
+        carveGrid(GD, &arena);
+        GD->gridMemory = aligned_alloc(64, arena.used);
+        if (GD->gridMemory == NULL) {
+                fprintf(stderr, "Out of memory for a %dx%d grid\n", config.width, config.height);
+                return false;
+        }
+        arena = (GridArena) { .base = GD->gridMemory, .used = 0 };
+        carveGrid(GD, &arena);
+
+        rng_seed(&GD->rng, seed);
+        InitializeTetriminoCollection(&GD->tetrominoCollection);
+        if (GD->tetrominoCollection.tetrominos == NULL) {
+                sim_cleanup(GD);
+                return false;
+        }
+
+#if defined(__SSE2__)
+        GD->simdFall = true;
+#else
+        GD->simdFall = false;
+#endif
+        if (!sim_setStepper(GD, SIM_STEPPER_STRIPES, 0)) {
+                sim_cleanup(GD);
+                return false;
+        }
+
+        GD->gameStarted = false;
+        sim_reset(GD);
+        return true;
+}
+
+bool sim_setStepper(GameData* GD, SimStepper stepper, int threads) {
+        workpool_destroy(GD->pool);
+        GD->pool = NULL;
+        GD->stepper = stepper;
+
+        // A pass has at most half the stripes to hand out, more threads would only wait
+        if (threads <= 0) {
+                threads = workpool_cores();
+        }
+        threads = SIM_CLAMP(threads, 1, (GD->stripes + 1) / 2);
+        if (stepper == SIM_STEPPER_STRIPES && threads > 1) {
+                GD->pool = workpool_create(threads);
+                if (GD->pool == NULL) {
+                        fprintf(stderr, "Sand worker pool creation failed!\n");
+                        return false;
+                }
+        }
+        return true;
+}
+
+void sim_reset(GameData* GD) {
+        GD->gameOver = false;
+        GD->gamePaused = false;
+
+        GD->sandRemoveTrigger = false;
+        GD->score = 0;
+        GD->sandAccumulator = 0.0f;
+        GD->removalTimer = 0.0f;
+        GD->effectCount = 0;
+
+        // Initializing colorGrid to have no sand particles
+        int width = GD->config.width;
+        int height = GD->config.height;
+        memset(GD->colorGrid, COLOR_NONE, (size_t) width * height);
+        memset(GD->occupancy, 0, sizeof(uint64_t) * height * GD->rowWords);
+        for (int x = 0; x < width; x++) {
+                GD->columnTop[x] = height;
+        }
+        for (int color = 0; color < COLOR_COUNT; color++) {
+                memset(GD->colorColumnCount[color], 0, sizeof(uint16_t) * width);
+        }
+        memset(GD->colorColumnsCovered, 0, sizeof(GD->colorColumnsCovered));
+        GD->clearanceDirtyColors = 0;
+        GD->markedSandCount = 0;
+        memset(GD->markedInRow, 0, sizeof(uint16_t) * height);
+        memset(GD->dirtyRows, 0xFF, sizeof(uint64_t) * DIRTY_ROW_WORDS(height));
+        wakeAllChunks(GD, false);
+        for (int stripe = 0; stripe < GD->stripes; stripe++) {
+                rng_split(&GD->rng, &GD->stripeRng[stripe]);
+        }
+
+        // Initialize Current Tetrimono
+        InitializeTetriminoData(&GD->rng, &GD->tetrominoCollection, &GD->currentTetromino);
+        SimRect rect = sim_tetrominoBounds(&GD->currentTetromino);
+        GD->currentTetromino.x = GAME_POS_X + (width - rect.w) * 0.5f - rect.x;
+        GD->currentTetromino.y = GAME_POS_Y - rect.h;
+
+        GD->ghostTetromino = GD->currentTetromino;
+
+        // Initialize Next Tetrimono
+        InitializeTetriminoData(&GD->rng, &GD->tetrominoCollection, &GD->nextTetromino);
+        rect = sim_tetrominoBounds(&GD->nextTetromino);
+        GD->nextTetromino.x = INFO_PANEL_X + (INFO_PANEL_WIDTH - rect.w) * 0.5f - rect.x;
+        GD->nextTetromino.y = INFO_PANEL_Y + (INFO_PANEL_HEIGHT) * 0.05f;
+}
+
+void sim_syncGrid(GameData* GD) {
+        int width = GD->config.width;
+        int height = GD->config.height;
+        buildPlane(GD, GD->occupancy, COLOR_NONE, true, 0, height);
+        for (int color = 0; color < COLOR_COUNT; color++) {
+                memset(GD->colorColumnCount[color], 0, sizeof(uint16_t) * width);
+        }
+        memset(GD->colorColumnsCovered, 0, sizeof(GD->colorColumnsCovered));
+        GD->clearanceDirtyColors = 0;
+        GD->markedSandCount = 0;
+        memset(GD->markedInRow, 0, sizeof(uint16_t) * height);
+        memset(GD->dirtyRows, 0xFF, sizeof(uint64_t) * DIRTY_ROW_WORDS(height));
+        wakeAllChunks(GD, true);
+
+        for (int x = 0; x < width; x++) {
+                GD->columnTop[x] = height;
+        }
+        for (int y = height - 1; y >= 0; y--) {
+                const uint8_t* row = sim_row(GD, y);
+                const uint64_t* occupied = GD->occupancy + (size_t) y * GD->rowWords;
+                int marked = 0;
+                for (int w = 0; w < GD->rowWords; w++) {
+                        for (uint64_t bits = occupied[w]; bits; bits &= bits - 1) {
+                                int x = w * 64 + __builtin_ctzll(bits);
+                                GD->columnTop[x] = y;
+                                countCell(GD, row[x], x, +1);
+                                marked += row[x] == COLOR_DELETE_MARKED_SAND;
+                        }
+                }
+                GD->markedInRow[y] = marked;
+                GD->markedSandCount += marked;
+        }
+}
+
+uint64_t sim_hashGrid(const GameData* GD) {
+        uint64_t hash = 0xCBF29CE484222325ull;
+        const uint8_t* cell = GD->colorGrid;
+        const uint8_t* last = cell + (size_t) GD->config.width * GD->config.height;
+        for (; cell < last; cell++) {
+                hash = (hash ^ *cell) * 0x100000001B3ull;
+        }
+        return hash;
+}
+
+void sim_cleanup(GameData* GD) {
+        CleanUpTetriminoCollection(&GD->tetrominoCollection);
+        GD->tetrominoCollection.tetrominos = NULL;
+        free(GD->gridMemory);
+        GD->gridMemory = NULL;
+        GD->runs = NULL;
+        workpool_destroy(GD->pool);
+        GD->pool = NULL;
+}
+
+// Also Updates score, returns true on the step the marked sand actually got removed
+static bool removeParticlesGracefully(GameData* GD, float deltaTime) {
+        GD->removalTimer += deltaTime;
+
+        if (GD->removalTimer > (TIME_FOR_SAND_DELETION - 0.1f)) {
+                GD->score += removeMarkedSand(GD);
+
+                // Additinal Reward for scoring: half the current falling tetrimino falling
+                GD->currentTetromino.velY = GD->currentTetromino.velY * 0.5f;
+
+                GD->sandRemoveTrigger = false;
+                GD->removalTimer = 0.0f;
+                return true;
+        }
+        return false;
+}
+
+// Mask of bits [x0, x1] that fall into word w
+static inline uint64_t rangeMask(int w, int x0, int x1) {
+        int lo = x0 - w * 64;
+        int hi = x1 - w * 64;
+        uint64_t mask = ~0ull;
+        if (lo > 0) mask &= ~0ull << lo;
+        if (hi < 63) mask &= ~0ull >> (63 - hi);
+        return mask;
+}
+
+// One grain of row y, the original per cell rule
+static inline void stepGrain(SandStepper* S, GridShape G, int y, int x) {
+        const uint8_t* row = cellRow(S->GD, G, y);
+        const uint8_t* below = row + G.width;
+
+        if (row[x] == COLOR_DELETE_MARKED_SAND) {
+                return;
+        }
+        if ((x == S->x0 && S->arrivedLeft[y]) || (x == S->x1 && S->arrivedRight[y])) {
+                return; // Came over from a neighbour stripe this step, one move per step
+        }
+
+        // Check if cell below is empty
+        if (below[x] == COLOR_NONE) {
+                // Move straight down
+                moveSand(S, G, y, x, y + 1, x);
+                return;
+        }
+
+        int try_left_first = stepperCoinFlip(S);
+        if (try_left_first) {
+                if (x > 0 && below[x - 1] == COLOR_NONE) {
+                        moveSand(S, G, y, x, y + 1, x - 1);
+                        return;
+                }
+                if (x < G.width - 1 && below[x + 1] == COLOR_NONE) {
+                        moveSand(S, G, y, x, y + 1, x + 1);
+                        return;
+                }
+        } else {
+                if (x < G.width - 1 && below[x + 1] == COLOR_NONE) {
+                        moveSand(S, G, y, x, y + 1, x + 1);
+                        return;
+                }
+                if (x > 0 && below[x - 1] == COLOR_NONE) {
+                        moveSand(S, G, y, x, y + 1, x - 1);
+                        return;
+                }
+        }
+}
+
+#if defined(__SSE2__)
+// Cells x0..x1 of row y inside one full chunk, 16 at a time.
+// Only a grain that is blocked below can change what comes after it in the row (it may slide
+// into the cell below its right neighbour), so every grain left of the first blocked one that
+// has room below drops in one go. The blocked one takes the scalar path and the rest of the
+// span carries on from there. Same moves, same coin flips, same order as stepGrain
+static void fallSpanSSE2(SandStepper* S, GridShape G, int y, int x0, int x1) {
+        GameData* GD = S->GD;
+        int base = x0 & ~(CHUNK_SIZE - 1);
+        uint8_t* row = cellRow(GD, G, y) + base;
+        uint8_t* below = cellRow(GD, G, y + 1) + base;
+
+        const __m128i none = _mm_set1_epi8(COLOR_NONE);
+        const __m128i marked = _mm_set1_epi8(COLOR_DELETE_MARKED_SAND);
+        const __m128i lanes = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+        int from = x0 - base;
+        int to = x1 - base;
+        unsigned span = ((2u << to) - 1) & ~((1u << from) - 1);
+
+        __m128i cur = _mm_loadu_si128((const __m128i*) row);
+        __m128i notGrain = _mm_or_si128(_mm_cmpeq_epi8(cur, none), _mm_cmpeq_epi8(cur, marked));
+        unsigned grains = ~(unsigned) _mm_movemask_epi8(notGrain) & span;
+        unsigned room = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) below), none));
+
+        // Nothing can fall straight down (cells below only fill up during a row), or a grain pushed in
+        // from the neighbour stripe sits at the edge and must stay put: plain per grain rule
+        bool arrived = (base == S->x0 && S->arrivedLeft[y]) || (base + CHUNK_SIZE - 1 == S->x1 && S->arrivedRight[y]);
+        bool scalar = (grains & room) == 0 || arrived;
+
+        while (grains && !scalar) {
+                unsigned blocked = grains & ~room;
+                int stop = blocked? __builtin_ctz(blocked): to + 1;
+                if (stop <= from + 1) {
+                        // Blocked grains packed in (checkerboards, slopes): a round would drop one grain at most,
+                        // less work to go one by one from here
+                        scalar = true;
+                        break;
+                }
+                unsigned falling = grains & ((1u << stop) - 1); // All of these have room
+
+                if (falling) {
+                        // Earlier scalar moves only touched cells left of here, reload and blend
+                        cur = _mm_loadu_si128((const __m128i*) row);
+                        __m128i under = _mm_loadu_si128((const __m128i*) below);
+                        __m128i fall = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi8(cur, none), _mm_cmpeq_epi8(cur, marked)), _mm_cmpeq_epi8(under, none));
+                        fall = _mm_and_si128(fall, _mm_and_si128(_mm_cmpgt_epi8(lanes, _mm_set1_epi8(from - 1)), _mm_cmplt_epi8(lanes, _mm_set1_epi8(stop))));
+
+                        _mm_storeu_si128((__m128i*) below, _mm_or_si128(_mm_and_si128(fall, cur), _mm_andnot_si128(fall, under)));
+                        _mm_storeu_si128((__m128i*) row, _mm_or_si128(_mm_and_si128(fall, none), _mm_andnot_si128(fall, cur)));
+
+                        int word = GRID_BIT_WORD(base);
+                        uint64_t bits = (uint64_t) falling << (base & 63);
+                        stepperSetBit(S, &occupancyRow(GD, G, y + 1)[word], bits);
+                        stepperClearBit(S, &occupancyRow(GD, G, y)[word], bits);
+                        for (unsigned lanesLeft = falling; lanesLeft; lanesLeft &= lanesLeft - 1) {
+                                int x = base + __builtin_ctz(lanesLeft);
+                                if (GD->columnTop[x] == y) GD->columnTop[x] = y + 1; // Top grain moved down, the cell below was empty
+                        }
+
+                        // Bounding boxes, so one mark for the lot is the same as one per grain
+                        int first = base + __builtin_ctz(falling);
+                        int last = base + 31 - __builtin_clz(falling);
+                        markDirtyRow(GD, G, y + 1, first, last, false);
+                        wakeAbove(S, G, y, first, last);
+                        stepperDirtyRows(S, y);
+
+                        for (int color = 0; color < COLOR_COUNT; color++) {
+                                if (_mm_movemask_epi8(_mm_and_si128(fall, _mm_cmpeq_epi8(cur, _mm_set1_epi8(color))))) {
+                                        S->dirtyColors |= 1u << color;
+                                }
+                        }
+                }
+
+                if (!blocked) {
+                        return;
+                }
+
+                // The blocked grain may slide into the cell below its right neighbour
+                stepGrain(S, G, y, base + stop);
+                grains &= ~0u << (stop + 1);
+                from = stop + 1;
+                if (from < CHUNK_SIZE && below[from] != COLOR_NONE) {
+                        room &= ~(1u << from);
+                }
+        }
+
+        while (grains) {
+                int lane = __builtin_ctz(grains);
+                grains &= grains - 1;
+                stepGrain(S, G, y, base + lane);
+        }
+}
+#endif
+
+// Steps row y over the awake chunks cx0..cx1
+SIM_KERNEL void stepSandRow(SandStepper* S, GridShape G, int y, int cx0, int cx1) {
+        GameData* GD = S->GD;
+        SandChunk* chunks = chunkRow(GD, G, y / CHUNK_SIZE);
+
+        // Chunks left to right, so cells are still visited in column order
+        for (int cx = cx0; cx <= cx1; cx++) {
+                const ChunkRect* dirty = &chunks[cx].dirty; // Can grow while stepping, re-read every row
+                if (!chunks[cx].awake || y < dirty->y0 || y > dirty->y1) {
+                        continue;
+                }
+
+#if defined(__SSE2__)
+                // Partial chunk at the right edge stays scalar, loads would run past the row. So does a span
+                // where nothing has room straight below (packed sand), the kernel would go one by one anyway
+                if (GD->simdFall && cx * CHUNK_SIZE + CHUNK_SIZE <= G.width) {
+                        int w = GRID_BIT_WORD(dirty->x0);
+                        uint64_t drops = __atomic_load_n(&occupancyRow(GD, G, y)[w], __ATOMIC_RELAXED)
+                                & ~__atomic_load_n(&occupancyRow(GD, G, y + 1)[w], __ATOMIC_RELAXED) & rangeMask(w, dirty->x0, dirty->x1);
+                        if (drops) {
+                                fallSpanSSE2(S, G, y, dirty->x0, dirty->x1);
+                                continue;
+                        }
+                }
+#endif
+
+                // Occupied columns of the dirty span, 64 at a time from the occupancy plane.
+                // Moves only clear bits of this row that were already visited, so the copy stays valid
+                const uint64_t* occupancy = occupancyRow(GD, G, y);
+                for (int w = GRID_BIT_WORD(dirty->x0); w <= GRID_BIT_WORD(dirty->x1); w++) {
+                        uint64_t occupied = __atomic_load_n(&occupancy[w], __ATOMIC_RELAXED) & rangeMask(w, dirty->x0, dirty->x1);
+                        while (occupied) {
+                                int x = w * 64 + __builtin_ctzll(occupied);
+                                occupied &= occupied - 1;
+                                stepGrain(S, G, y, x);
+                        }
+                }
+        }
+}
+
+// All rows bottom to top over chunk columns cx0..cx1, chunk rows with nothing awake are skipped whole.
+// Wake ups only ever go one row up, so a chunk row is checked once the step gets to it
+SIM_KERNEL void stepSandRowsShaped(SandStepper* S, GridShape G, int cx0, int cx1) {
+        for (int cy = SHAPE_CHUNKS_Y(G) - 1; cy >= 0; cy--) {
+                const SandChunk* chunks = chunkRow(S->GD, G, cy);
+                bool awake = false;
+                for (int cx = cx0; cx <= cx1; cx++) {
+                        awake |= chunks[cx].awake;
+                }
+                if (!awake) {
+                        continue;
+                }
+
+                // Process from bottom to top (second-to-bottom row up to top)
+                int yBottom = SIM_CLAMP(cy * CHUNK_SIZE + CHUNK_SIZE - 1, 0, G.height - 2);
+                for (int y = yBottom; y >= cy * CHUNK_SIZE; y--) {
+                        stepSandRow(S, G, y, cx0, cx1);
+                }
+        }
+}
+
+// The hot loops, once per size in SIM_KERNEL_SIZES with the size folded in, and once for any size
+typedef struct SandKernels {
+        int width, height;
+        void (*stepRows)(SandStepper* S, int cx0, int cx1);
+        void (*buildPlane)(const GameData* GD, uint64_t* plane, int value, bool invert, int y0, int y1);
+} SandKernels;
+
+// The game's grid at SCALE_FACTOR 1, 2 and 4. Other sizes run the any size copy, same results
+#define SIM_KERNEL_SIZES(X) \
+        X(140, 210) \
+        X(280, 420) \
+        X(560, 840)
+
+#define SIM_SIZED_KERNELS(w, h) \
+        static void stepSandRows_##w##x##h(SandStepper* S, int cx0, int cx1) { \
+                stepSandRowsShaped(S, GRID_SHAPE(w, h), cx0, cx1); \
+        } \
+        static void buildPlane_##w##x##h(const GameData* GD, uint64_t* plane, int value, bool invert, int y0, int y1) { \
+                buildPlaneShaped(GD, GRID_SHAPE(w, h), plane, value, invert, y0, y1); \
+        }
+SIM_KERNEL_SIZES(SIM_SIZED_KERNELS)
+
+static void stepSandRowsAnySize(SandStepper* S, int cx0, int cx1) {
+        stepSandRowsShaped(S, gridShape(S->GD), cx0, cx1);
+}
+
+static void buildPlaneAnySize(const GameData* GD, uint64_t* plane, int value, bool invert, int y0, int y1) {
+        buildPlaneShaped(GD, gridShape(GD), plane, value, invert, y0, y1);
+}
+
+#define SIM_KERNEL_ENTRY(w, h) { w, h, stepSandRows_##w##x##h, buildPlane_##w##x##h },
+static const SandKernels SIZED_KERNELS[] = { SIM_KERNEL_SIZES(SIM_KERNEL_ENTRY) };
+static const SandKernels ANY_SIZE_KERNELS = { 0, 0, stepSandRowsAnySize, buildPlaneAnySize };
+
+static const SandKernels* findKernels(int width, int height) {
+        for (size_t i = 0; i < sizeof(SIZED_KERNELS) / sizeof(SIZED_KERNELS[0]); i++) {
+                if (SIZED_KERNELS[i].width == width && SIZED_KERNELS[i].height == height) {
+                        return &SIZED_KERNELS[i];
+                }
+        }
+        return NULL;
+}
+
+static inline const SandKernels* kernelsOf(const GameData* GD) {
+        return (GD->sizedKernels && GD->kernels)? GD->kernels: &ANY_SIZE_KERNELS;
+}
+
+static void buildPlane(const GameData* GD, uint64_t* plane, int value, bool invert, int y0, int y1) {
+        kernelsOf(GD)->buildPlane(GD, plane, value, invert, y0, y1);
+}
+
+typedef struct {
+        SandStepper* steppers;
+        void (*stepRows)(SandStepper* S, int cx0, int cx1);
+        int chunksX;
+        int parity; // Stripes of this parity run in the current pass
+} StripePass;
+
+static void stepStripe(void* ctx, int job) {
+        StripePass* pass = ctx;
+        int stripe = job * 2 + pass->parity;
+        SandStepper* S = &pass->steppers[stripe];
+        TraceZone zone = trace_begin("sand stripe");
+
+        // Whole column of the stripe, bottom to top, same as the serial scan
+        int cx0 = stripe * (SAND_STRIPE_WIDTH / CHUNK_SIZE);
+        int cx1 = SIM_CLAMP(cx0 + SAND_STRIPE_WIDTH / CHUNK_SIZE - 1, 0, pass->chunksX - 1);
+        pass->stepRows(S, cx0, cx1);
+        memset(S->arrivedLeft, 0, 2 * (size_t) S->GD->config.height); // Both halves, see carveGrid
+        trace_end(zone);
+}
+
+// Fresh stepper over columns x0..x1, keeps its dirty row and arrival storage
+static void stepperStart(GameData* GD, SandStepper* S, int x0, int x1, SimRng* rng) {
+        *S = (SandStepper) {
+                .GD = GD, .x0 = x0, .x1 = x1, .rng = rng,
+                .dirtyRows = S->dirtyRows, .arrivedLeft = S->arrivedLeft, .arrivedRight = S->arrivedRight,
+        };
+        memset(S->dirtyRows, 0, sizeof(uint64_t) * DIRTY_ROW_WORDS(GD->config.height));
+}
+
+#define SAND_PARALLEL_CHUNKS 24 // Fewer awake chunks are stepped before the workers would wake up
+
+// One sand sub-step, only over the dirty part of awake chunks
+static void stepSandParticles(GameData* GD) {
+        // What was collected since the last step is what gets visited now
+        int chunkCount = GD->chunksX * GD->chunksY;
+        GD->awakeChunks = 0;
+        for (int i = 0; i < chunkCount; i++) {
+                SandChunk* chunk = &GD->chunks[i];
+                chunk->dirty = chunk->nextDirty;
+                chunk->nextDirty = EMPTY_CHUNK_RECT;
+                chunk->awake = chunk->dirty.x0 <= chunk->dirty.x1;
+                GD->awakeChunks += chunk->awake;
+        }
+
+        // Even stripes then odd ones, on the pool or one after the other on this thread: same moves
+        // either way. A grain that slides into a stripe still to run is flagged there (see moveSand),
+        // so it isn't stepped twice
+        StripePass pass = { .steppers = GD->steppers, .stepRows = kernelsOf(GD)->stepRows, .chunksX = GD->chunksX };
+        bool parallel = GD->pool != NULL && GD->awakeChunks >= SAND_PARALLEL_CHUNKS;
+        bool concurrent = parallel && workpool_threads(GD->pool) > 1;
+        for (int stripe = 0; stripe < GD->stripes; stripe++) {
+                SandStepper* S = &pass.steppers[stripe];
+                stepperStart(GD, S, stripe * SAND_STRIPE_WIDTH, SIM_CLAMP(stripe * SAND_STRIPE_WIDTH + SAND_STRIPE_WIDTH - 1, 0, GD->config.width - 1),
+                        &GD->stripeRng[stripe]);
+                S->neighboursLater = stripe % 2 == 0;
+                S->concurrent = concurrent;
+        }
+        for (int stripe = 0; stripe < GD->stripes; stripe += 2) {
+                SandStepper* S = &pass.steppers[stripe];
+                S->pushLeft = (stripe > 0)? pass.steppers[stripe - 1].arrivedRight: NULL;
+                S->pushRight = (stripe + 1 < GD->stripes)? pass.steppers[stripe + 1].arrivedLeft: NULL;
+        }
+        for (pass.parity = 0; pass.parity < 2; pass.parity++) {
+                int jobs = (GD->stripes - pass.parity + 1) / 2;
+                if (parallel) {
+                        workpool_run(GD->pool, jobs, stepStripe, &pass);
+                } else {
+                        for (int job = 0; job < jobs; job++) {
+                                stepStripe(&pass, job);
+                        }
+                }
+        }
+        for (int stripe = 0; stripe < GD->stripes; stripe++) {
+                stepperFinish(GD, &pass.steppers[stripe]);
+        }
+}
+
+static bool update_sand_particle_falling(GameData* GD, float deltaTime, unsigned score) {
+        GD->sandAccumulator += deltaTime;
+
+        bool returnValue = false; // whether sands that need to be removed is in the colorGrid
+
+        int level = floor(score / 1500.0f) + 1;
+        while (GD->sandAccumulator >= SAND_STEP_TIME) { // Move the level, faster sand falls cause for fun!
+                GD->sandAccumulator -= fmax(SAND_STEP_TIME * 1 / 2.5f, (SAND_STEP_TIME / (level / 10.0f + 1)));
+                TraceZone zone = trace_begin("sand step");
+                stepSandParticles(GD);
+                trace_end(zone);
+                returnValue = GD->markedSandCount > 0;
+        }
+        return returnValue;
+}
+
+// Whether a piece row placed with its first pixel at grid column x overlaps any sand in this row
+static inline bool pieceRowHits(const uint64_t* row, int rowWords, const uint64_t bits[PIECE_MASK_WORDS], int x) {
+        int word = GRID_BIT_WORD(x);
+        int shift = x & 63;
+        for (int i = 0; i < PIECE_MASK_WORDS && word + i < rowWords; i++) {
+                if (row[word + i] & (bits[i] << shift)) return true;
+                if (shift && word + i + 1 < rowWords && (row[word + i + 1] & (bits[i] >> (64 - shift)))) return true;
+        }
+        return false;
+}
+
+// Row masks against the occupancy bitplane: a few word ANDs per pixel row instead of a grid read per pixel.
+// Positions round the same way as placing each block did (float -> int per block row), so results are exact
+static bool checkTetrominoCollision(const GameData* GD, const TetrominoData* TD) {
+        const PieceRowMask* rows = TD->shape->collisionRows[TD->rotation];
+
+        for (int row = 0; row < 4; row++) {
+                const PieceRowMask* mask = &rows[row];
+                if (mask->right < mask->left) {
+                        continue;
+                }
+
+                int gridX = (int) (TD->x + mask->left) - GAME_POS_X;
+                int gridY = (int) (TD->y + row * PARTICLE_COUNT_IN_BLOCK_ROW) - GAME_POS_Y;
+                int lastY = gridY + PARTICLE_COUNT_IN_BLOCK_ROW - 1;
+                if (lastY < 0) {
+                        continue; // Still above the field
+                }
+
+                // Walls and floor
+                if (gridX < 0 || gridX + (mask->right - mask->left) >= GD->config.width || lastY >= GD->config.height) {
+                        return true;
+                }
+
+                for (int y = (gridY > 0)? gridY: 0; y <= lastY; y++) {
+                        if (pieceRowHits(GD->occupancy + (size_t) y * GD->rowWords, GD->rowWords, mask->bits, gridX)) {
+                                return true;
+                        }
+                }
+        }
+
+        return false;
+}
+
+// Clearance: a same color region (4 directions) touching both the left and the right wall gets removed.
+// Regions are found with union-find over horizontal runs instead of flood fills, so nothing recurses
+// and the scratch memory is fixed (at most one run per cell) no matter how big a region gets.
+#define RUN_TOUCHES_LEFT 1
+#define RUN_TOUCHES_RIGHT 2
+#define RUN_SPANNING (RUN_TOUCHES_LEFT | RUN_TOUCHES_RIGHT)
+
+static inline int findRoot(SandRun* runs, int i) {
+        while (runs[i].parent != i) {
+                runs[i].parent = runs[runs[i].parent].parent; // Path halving
+                i = runs[i].parent;
+        }
+        return i;
+}
+
+// Returns true if the merged region now touches both walls
+static inline bool unionRuns(SandRun* runs, int a, int b) {
+        a = findRoot(runs, a);
+        b = findRoot(runs, b);
+        if (a != b) {
+                // Keep the older run as root, so roots always point backwards
+                if (b < a) {
+                        int t = a; a = b; b = t;
+                }
+                runs[b].parent = a;
+                runs[a].flags |= runs[b].flags;
+        }
+        return runs[a].flags == RUN_SPANNING;
+}
+
+// Next run of set bits at or after column `from`: [x0, x1). Word at a time, bits past the width are always 0
+static inline bool nextRun(const uint64_t* row, GridShape G, int from, int* x0, int* x1) {
+        int w = GRID_BIT_WORD(from);
+        uint64_t word = row[w] & (~0ull << (from & 63));
+        while (word == 0) {
+                if (++w >= SHAPE_ROW_WORDS(G)) return false;
+                word = row[w];
+        }
+        *x0 = w * 64 + __builtin_ctzll(word);
+
+        word = ~row[w] & (~0ull << (*x0 & 63));
+        while (word == 0) {
+                if (++w >= SHAPE_ROW_WORDS(G)) {
+                        *x1 = G.width;
+                        return true;
+                }
+                word = ~row[w];
+        }
+        *x1 = w * 64 + __builtin_ctzll(word);
+        if (*x1 > G.width) *x1 = G.width;
+        return true;
+}
+
+// setCell(COLOR_DELETE_MARKED_SAND) over a run, which is all one color: one write for the lot.
+// The cells stay occupied, so occupancy and the height map don't change
+static void markRun(GameData* GD, const SandRun* run) {
+        int length = run->x1 - run->x0 + 1;
+        for (int x = run->x0; x <= run->x1; x++) {
+                countCell(GD, run->color, x, -1);
+        }
+        memset(sim_row(GD, run->y) + run->x0, COLOR_DELETE_MARKED_SAND, length);
+        GD->markedSandCount += length;
+        GD->markedInRow[run->y] += length;
+        GD->dirtyRows[run->y >> 6] |= 1ull << (run->y & 63);
+        markDirtyRow(GD, gridShape(GD), run->y, run->x0, run->x1, false);
+}
+
+static inline void sandClearance(GameData* GD) {
+        GridShape G = gridShape(GD);
+        SandRun* runs = GD->runs;
+        int runCount = 0;
+
+        // Only colors that gained cells since the last check and show up in every column
+        // can have a new spanning region, everything else is treated as air.
+        // On a settled board this is where it stops.
+        unsigned candidates = 0;
+        for (int color = 0; color < COLOR_COUNT; color++) {
+                if ((GD->clearanceDirtyColors & (1u << color)) && GD->colorColumnsCovered[color] == G.width) {
+                        candidates |= 1u << color;
+                }
+        }
+        GD->clearanceDirtyColors = 0;
+        if (candidates == 0) {
+                return;
+        }
+
+        bool anySpanning = false;
+
+        for (int color = 0; color < COLOR_COUNT; color++) {
+                if (!(candidates & (1u << color))) {
+                        continue;
+                }
+
+                uint64_t* plane = GD->colorPlanes[color];
+                buildPlane(GD, plane, color, false, 0, G.height);
+
+                int prevStart = runCount, prevEnd = runCount; // Runs of the row above: [prevStart, prevEnd)
+                for (int y = 0; y < G.height; y++) {
+                        const uint64_t* planeRow = plane + (size_t) y * SHAPE_ROW_WORDS(G);
+                        int rowStart = runCount;
+                        int p = prevStart; // Walks the row above alongside this row
+
+                        for (int x = 0; x < G.width;) {
+                                int x0, x1;
+                                if (!nextRun(planeRow, G, x, &x0, &x1)) {
+                                        break;
+                                }
+                                x = x1;
+
+                                int r = runCount++;
+                                runs[r] = (SandRun) {
+                                        .x0 = x0,
+                                        .x1 = x1 - 1,
+                                        .y = y,
+                                        .color = color,
+                                        .flags = (x0 == 0? RUN_TOUCHES_LEFT: 0) | (x1 == G.width? RUN_TOUCHES_RIGHT: 0),
+                                        .parent = r,
+                                };
+                                anySpanning |= runs[r].flags == RUN_SPANNING;
+
+                                // Join with every overlapping run in the row above
+                                while (p < prevEnd && runs[p].x1 < x0) {
+                                        p++;
+                                }
+                                for (int q = p; q < prevEnd && runs[q].x0 < x1; q++) {
+                                        anySpanning |= unionRuns(runs, r, q);
+                                }
+                        }
+
+                        prevStart = rowStart;
+                        prevEnd = runCount;
+                }
+        }
+
+        if (!anySpanning) {
+                return;
+        }
+
+        for (int r = 0; r < runCount; r++) {
+                if (runs[findRoot(runs, r)].flags == RUN_SPANNING) {
+                        markRun(GD, &runs[r]);
+                }
+        }
+}
+
+// Removal of marked sand, split in bands of rows. Inside a band rows are independent: each
+// one only touches its own grid row, occupancy row and removed bits. Everything shared
+// (chunks, height map, counters) is done afterwards on the calling thread
+#define REMOVAL_BANDS 8
+#define REMOVAL_PARALLEL_CELLS (64 * 1024) // Smaller boxes are done before the workers would wake up
+
+typedef struct {
+        GameData* GD;
+        int y0, y1; // Rows between the first and last one holding marked sand
+        unsigned removed[REMOVAL_BANDS];
+} RemovalPass;
+
+static void removeMarkedBand(void* ctx, int band) {
+        RemovalPass* pass = ctx;
+        GameData* GD = pass->GD;
+        int y0 = pass->y0 + (pass->y1 - pass->y0) * band / REMOVAL_BANDS;
+        int y1 = pass->y0 + (pass->y1 - pass->y0) * (band + 1) / REMOVAL_BANDS;
+        GridShape G = gridShape(GD);
+        unsigned removed = 0;
+
+        for (int y = y0; y < y1; y++) {
+                if (GD->markedInRow[y] == 0) {
+                        continue;
+                }
+
+                uint8_t* row = cellRow(GD, G, y);
+                uint64_t* out = GD->removedPlane + (size_t) y * SHAPE_ROW_WORDS(G);
+                uint64_t* occupancy = occupancyRow(GD, G, y);
+                memset(out, 0, sizeof(uint64_t) * SHAPE_ROW_WORDS(G));
+
+                int x = 0;
+#if defined(__SSE2__)
+                const __m128i marked = _mm_set1_epi8(COLOR_DELETE_MARKED_SAND);
+                const __m128i none = _mm_set1_epi8(COLOR_NONE);
+                for (; x + 16 <= G.width; x += 16) {
+                        __m128i cells = _mm_loadu_si128((const __m128i*) (row + x));
+                        __m128i hit = _mm_cmpeq_epi8(cells, marked);
+                        _mm_storeu_si128((__m128i*) (row + x), _mm_or_si128(_mm_and_si128(hit, none), _mm_andnot_si128(hit, cells)));
+                        out[GRID_BIT_WORD(x)] |= (uint64_t) (uint16_t) _mm_movemask_epi8(hit) << (x & 63);
+                }
+#endif
+                for (; x < G.width; x++) {
+                        if (row[x] == COLOR_DELETE_MARKED_SAND) {
+                                row[x] = COLOR_NONE;
+                                out[GRID_BIT_WORD(x)] |= GRID_BIT_MASK(x);
+                        }
+                }
+
+                for (int w = 0; w < SHAPE_ROW_WORDS(G); w++) {
+                        occupancy[w] &= ~out[w];
+                        removed += __builtin_popcountll(out[w]);
+                }
+        }
+        pass->removed[band] = removed;
+}
+
+// Same end state as setCell(COLOR_NONE) on every marked cell, without visiting the rest of the grid
+static unsigned removeMarkedSand(GameData* GD) {
+        GridShape G = gridShape(GD);
+        int y0 = 0;
+        int y1 = G.height;
+        while (y0 < y1 && GD->markedInRow[y0] == 0) y0++;
+        while (y1 > y0 && GD->markedInRow[y1 - 1] == 0) y1--;
+        if (y0 == y1) {
+                return 0;
+        }
+
+        RemovalPass pass = { .GD = GD, .y0 = y0, .y1 = y1 };
+        if ((y1 - y0) * G.width >= REMOVAL_PARALLEL_CELLS && workpool_threads(GD->pool) > 1) {
+                workpool_run(GD->pool, REMOVAL_BANDS, removeMarkedBand, &pass);
+        } else {
+                for (int band = 0; band < REMOVAL_BANDS; band++) {
+                        removeMarkedBand(&pass, band);
+                }
+        }
+
+        unsigned removed = 0;
+        for (int band = 0; band < REMOVAL_BANDS; band++) {
+                removed += pass.removed[band];
+        }
+
+        // Scratch rows: the columns that lost cells, the wake mask of a row and the columns still looking for a top
+        uint64_t columns[GRID_ROW_WORDS(SIM_MAX_SIZE)] = { 0 };
+        uint64_t wake[GRID_ROW_WORDS(SIM_MAX_SIZE)];
+        uint64_t pending[GRID_ROW_WORDS(SIM_MAX_SIZE)];
+        for (int y = y0; y < y1; y++) {
+                if (GD->markedInRow[y] == 0) {
+                        continue;
+                }
+                GD->markedInRow[y] = 0;
+                GD->dirtyRows[y >> 6] |= 1ull << (y & 63);
+
+                // An emptied cell wakes the three above it: the removed bits grown by one each way
+                const uint64_t* removed = GD->removedPlane + (size_t) y * SHAPE_ROW_WORDS(G);
+                for (int w = 0; w < SHAPE_ROW_WORDS(G); w++) {
+                        wake[w] = removed[w] | (removed[w] << 1) | (removed[w] >> 1);
+                        if (w > 0) wake[w] |= removed[w - 1] >> 63;
+                        if (w + 1 < SHAPE_ROW_WORDS(G)) wake[w] |= removed[w + 1] << 63;
+                        columns[w] |= removed[w];
+                }
+                if (G.width & 63) {
+                        wake[SHAPE_ROW_WORDS(G) - 1] &= ~0ull >> (64 - (G.width & 63));
+                }
+                markDirtyBits(GD, G, y - 1, wake);
+        }
+        GD->markedSandCount -= removed;
+
+        // Only columns that lost their top need a new one: walk down the occupancy rows for all of them at once
+        bool anyPending = false;
+        for (int w = 0; w < SHAPE_ROW_WORDS(G); w++) {
+                pending[w] = 0;
+                for (uint64_t bits = columns[w]; bits; bits &= bits - 1) {
+                        int x = w * 64 + __builtin_ctzll(bits);
+                        if (cellRow(GD, G, GD->columnTop[x])[x] == COLOR_NONE) {
+                                pending[w] |= GRID_BIT_MASK(x);
+                                GD->columnTop[x] = G.height;
+                                anyPending = true;
+                        }
+                }
+        }
+        for (int y = y0; y < G.height && anyPending; y++) { // The old tops were marked, so at y0 or below
+                anyPending = false;
+                const uint64_t* occupancy = occupancyRow(GD, G, y);
+                for (int w = 0; w < SHAPE_ROW_WORDS(G); w++) {
+                        for (uint64_t hits = pending[w] & occupancy[w]; hits; hits &= hits - 1) {
+                                GD->columnTop[w * 64 + __builtin_ctzll(hits)] = y;
+                        }
+                        pending[w] &= ~occupancy[w];
+                        anyPending |= pending[w] != 0;
+                }
+        }
+        return removed;
+}
+
+static void checkIfGameOver(GameData* GD) {
+        // if sand reaches a hight more than container
+        if (!rowEmpty(GD->occupancy + GD->rowWords, GD->rowWords)) {
+                GD->gameOver = true;
+        }
+};
+
+// Update ghost tetromino position
+static void updateGhostTetromino(GameData* GD) {
+        // Copy current tetromino properties
+        GD->ghostTetromino = GD->currentTetromino;
+        GD->ghostTetromino.y = sim_dropY(GD, &GD->currentTetromino);
+}
+
+// Piece controls, same rules the keyboard handling used to apply directly
+static SimEvents applyInput(GameData* GD, SimInput input, float dt) {
+        SimEvents events = SIM_EVENT_NONE;
+        TetrominoData* TD = &GD->currentTetromino;
+
+        if (input & SIM_INPUT_PAUSE) {
+                GD->gamePaused = !GD->gamePaused;
+        }
+
+        if (GD->gameOver || GD->gameStarted == false) {
+                if (input & SIM_INPUT_START) {
+                        GD->gameStarted = true;
+                        sim_reset(GD);
+                        events |= SIM_EVENT_STARTED;
+                }
+                return events;
+        }
+
+        if (GD->gamePaused) {
+                return events;
+        }
+
+        bool aboveField = sim_tetrominoBounds(TD).y < GAME_POS_Y;
+        if ((input & SIM_INPUT_ROTATE_CW) && !aboveField) {
+                TD->rotation = (TD->rotation + 1) % 4;
+        }
+        if ((input & SIM_INPUT_ROTATE_CCW) && !aboveField) {
+                TD->rotation = (TD->rotation > 0)? TD->rotation - 1: 3;
+        }
+        if ((input & SIM_INPUT_HARD_DROP) && !aboveField) {
+                TD->y = sim_dropY(GD, TD); // Not the ghost: that one is from before this tick's rotation
+                destroyCurrentTetromino(GD);
+                events |= SIM_EVENT_PIECE_LOCKED;
+        }
+
+        // Move Current Tetrimino
+        // TODO: smoother control
+        if (input & SIM_INPUT_LEFT) {
+                TD->x -= TETRIMINO_MOVE_SPEED * dt;
+        }
+        if (input & SIM_INPUT_RIGHT) {
+                TD->x += TETRIMINO_MOVE_SPEED * dt;
+        }
+
+        // Clamp position: to inbetween walls
+        int minCol = 4;
+        int maxCol = -1;
+        const unsigned short (*shape)[4] = TD->shape->shape[TD->rotation];
+        for (int row = 0; row < 4; row++) {
+                for (int col = 0; col < 4; col++) {
+                        if (shape[row][col]) {
+                                if (col < minCol) minCol = col;
+                                if (col > maxCol) maxCol = col;
+                        }
+                }
+        }
+
+        int minX = GAME_POS_X + -minCol * PARTICLE_COUNT_IN_BLOCK_COLUMN;
+        int maxX = GAME_POS_X + GD->config.width - (maxCol + 1) * PARTICLE_COUNT_IN_BLOCK_COLUMN;
+        TD->x = SIM_CLAMP(TD->x, minX, maxX);
+
+        return events;
+}
+
+bool sim_startEffect(GameData* GD, SimEffectKind kind, float duration) {
+        if (GD->effectCount == SIM_MAX_EFFECTS) {
+                return false;
+        }
+        GD->effects[GD->effectCount++] = (SimEffect) { .kind = kind, .elapsed = 0.0f, .duration = duration };
+        return true;
+}
+
+float sim_effectProgress(const GameData* GD, SimEffectKind kind) {
+        for (int i = GD->effectCount - 1; i >= 0; i--) {
+                const SimEffect* effect = &GD->effects[i];
+                if (effect->kind == kind) {
+                        return (effect->duration > 0.0f)? effect->elapsed / effect->duration: 1.0f;
+                }
+        }
+        return -1.0f;
+}
+
+// Drops the ones that ran their course, keeping the rest in start order
+static void advanceEffects(GameData* GD, float dt) {
+        int kept = 0;
+        for (int i = 0; i < GD->effectCount; i++) {
+                SimEffect effect = GD->effects[i];
+                effect.elapsed += dt;
+                if (effect.elapsed < effect.duration) {
+                        GD->effects[kept++] = effect;
+                }
+        }
+        GD->effectCount = kept;
+}
+
+SimEvents sim_step(GameData* GD, SimInput input, float dt) {
+        SimEvents events = applyInput(GD, input, dt);
+        TetrominoData* TD = &GD->currentTetromino;
+
+        if (GD->gameStarted == false || GD->gamePaused || (events & SIM_EVENT_STARTED)) {
+                return events;
+        }
+
+        bool wasGameOver = GD->gameOver;
+        checkIfGameOver(GD);
+        if (GD->gameOver) {
+                if (!wasGameOver) {
+                        events |= SIM_EVENT_GAME_OVER;
+                }
+                return events;
+        }
+
+        advanceEffects(GD, dt);
+        if (sim_effectProgress(GD, SIM_EFFECT_CLEAR_HITSTOP) >= 0.0f) {
+                // Hit-stop: sand and gravity wait, moves and rotations made above still land
+                updateGhostTetromino(GD);
+                return events;
+        }
+
+        if ((GD->sandRemoveTrigger = update_sand_particle_falling(GD, dt, GD->score))) {
+                TraceZone zone = trace_begin("remove marked");
+                bool cleared = removeParticlesGracefully(GD, dt);
+                trace_end(zone);
+                if (cleared) {
+                        events |= SIM_EVENT_SAND_CLEARED;
+                        sim_startEffect(GD, SIM_EFFECT_CLEAR_HITSTOP, CLEAR_HITSTOP_TIME);
+                        sim_startEffect(GD, SIM_EFFECT_CLEAR_FLASH, CLEAR_FLASH_TIME);
+                }
+        }
+
+        // Steps
+        // 1. Check if current tetromino is colliding
+        //      1.a if it is, convert that to sand and add to colorGrid, swap currentTetromino to nextTetromino and spawn newTetromino for nextTetromino
+        //              Note: make sure to set the x, y to different for new tetromino
+        //      1.b if it's not, Update current tetromino's location
+        // Apply gravity and move tetromino
+        float fallSpeed = GRAVITY * (1 + (floor(GD->score / 1500.0f) + 1) * 0.3f);
+        TD->velY += fallSpeed * dt;
+
+        float oldY = TD->y;
+        TD->y += TD->velY * dt;
+
+        // Check if the new position causes a collision
+        if (checkTetrominoCollision(GD, TD)) {
+                // Revert to old position
+                TD->y = oldY;
+                TD->velY = 0;
+
+                // Lock the piece in place
+                TraceZone zone = trace_begin("lock");
+                destroyCurrentTetromino(GD);
+                trace_end(zone);
+                events |= SIM_EVENT_PIECE_LOCKED;
+        }
+
+        // Update ghost tetromino position
+        TraceZone zone = trace_begin("ghost");
+        updateGhostTetromino(GD);
+        trace_end(zone);
+
+        // Maximum clearance algorithm, delete sand, ... score, level, ...
+        // 2. Maximum clearance
+        //      2.a Detect
+        //      2.b Convert all to color_none gracefully i.e go from COLOR_DELETE_MARKED_SAND to COLOR_NONE
+        zone = trace_begin("clearance");
+        sandClearance(GD);
+        trace_end(zone);
+
+        return events;
+}
+
+bool sim_stepSand(GameData* GD) {
+        stepSandParticles(GD);
+        return GD->markedSandCount > 0;
+}
+
+void sim_detectClearance(GameData* GD) {
+        sandClearance(GD);
+}
+
+// Same answer as moving the piece down a pixel at a time until it collides, which is what the
+// ghost used to do. The height map tells how far it surely falls freely: every bottom block row
+// is above the top of each of its columns. That part is skipped, the exact test does the rest
+float sim_dropY(const GameData* GD, const TetrominoData* TD) {
+        const PieceRowMask* rows = TD->shape->collisionRows[TD->rotation];
+        int freeFall = GD->config.height;
+
+        for (int row = 0; row < 4 && freeFall > 0; row++) {
+                const PieceRowMask* mask = &rows[row];
+                if (mask->right < mask->left) {
+                        continue;
+                }
+
+                int gridX = (int) (TD->x + mask->left) - GAME_POS_X;
+                int lastY = (int) (TD->y + row * PARTICLE_COUNT_IN_BLOCK_ROW) - GAME_POS_Y + PARTICLE_COUNT_IN_BLOCK_ROW - 1;
+                int width = mask->right - mask->left;
+                if (gridX < 0 || gridX + width >= GD->config.width) {
+                        freeFall = 0; // In a wall, leave it to the exact test
+                        break;
+                }
+
+                for (int bit = 0; bit <= width; bit++) {
+                        if ((mask->bits[bit >> 6] >> (bit & 63)) & 1) {
+                                int gap = GD->columnTop[gridX + bit] - lastY; // Empty column: the floor
+                                if (gap < freeFall) freeFall = gap;
+                        }
+                }
+        }
+
+        // y goes up in float steps like the pixel by pixel walk did, each block row then rounds on
+        // its own: a row can land up to 2 pixels lower than gap says, so stop that much short
+        TetrominoData ghost = *TD;
+        for (int i = 0; i < freeFall - 2; i++) {
+                ghost.y += 1;
+        }
+        while (!checkTetrominoCollision(GD, &ghost)) {
+                ghost.y += 1;
+        }
+        return ghost.y - 1; // One step too far
+}
+
+void sim_updateGhost(GameData* GD) {
+        updateGhostTetromino(GD);
+}
+
+unsigned sim_removeMarked(GameData* GD) {
+        return removeMarkedSand(GD);
+}
+
+void sim_takeDirtyRows(GameData* GD, uint64_t* rows) {
+        size_t bytes = sizeof(uint64_t) * DIRTY_ROW_WORDS(GD->config.height);
+        memcpy(rows, GD->dirtyRows, bytes);
+        memset(GD->dirtyRows, 0, bytes);
+
+        if (GD->markedSandCount > 0) {
+                for (int y = 0; y < GD->config.height; y++) {
+                        if (GD->markedInRow[y]) {
+                                rows[y >> 6] |= 1ull << (y & 63);
+                        }
+                }
+        }
+}
+
+SimRect sim_tetrominoBounds(const TetrominoData* TD) {
+        // Boundary
+        int minCol = 4;
+        int maxCol = -1;
+        int minRow = 4;
+        int maxRow = -1;
+
+        const unsigned short (*shape)[4] = TD->shape->shape[TD->rotation];
+        for (int row = 0; row < 4; row++) {
+                for (int col = 0; col < 4; col++) {
+                        if (shape[row][col]) {
+                                if (col < minCol) minCol = col;
+                                if (col > maxCol) maxCol = col;
+                                if (row < minRow) minRow = row;
+                                if (row > maxRow) maxRow = row;
+                        }
+                }
+        }
+
+        int pieceLeft = TD->x + minCol * PARTICLE_COUNT_IN_BLOCK_COLUMN;
+        int pieceRight = TD->x + (maxCol + 1) * PARTICLE_COUNT_IN_BLOCK_COLUMN;
+
+        int pieceTop = TD->y + minRow * PARTICLE_COUNT_IN_BLOCK_ROW;
+        int pieceBottom = TD->y + (maxRow + 1) * PARTICLE_COUNT_IN_BLOCK_ROW;
+
+        return (SimRect) {
+                .x = pieceLeft,
+                .w = pieceRight - pieceLeft,
+                .y = pieceTop,
+                .h = pieceBottom - pieceTop,
+        };
+}
+
+static inline void InitializeTetriminoCollection(TetrominoCollection* TC) {
+        TC->capacity = 5; // 4 Tetriminos: | Shaped, Z Shaped, Square Shaped, L Shape
+        TC->tetrominos = malloc(sizeof(struct Tetromino) * TC->capacity);
+        TC->count = 0;
+        if (TC->tetrominos == NULL) {
+                return;
+        }
+
+        TC->tetrominos[TC->count++] = (struct Tetromino) {
+                .name = "Line Tetrimino", // Display Name!
+                .shape = {
+                        { // Rotation 1: rotation left of rotation 4
+                                {0, 0, 0, 0},
+                                {1, 1, 1, 1},
+                                {0, 0, 0, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 2: rotation left of rotation 1
+                                {0, 1, 0, 0},
+                                {0, 1, 0, 0},
+                                {0, 1, 0, 0},
+                                {0, 1, 0, 0},
+                        },
+                        { // Rotation 3: rotation left of rotation 2
+                                {0, 0, 0, 0},
+                                {0, 0, 0, 0},
+                                {1, 1, 1, 1},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 4: rotation left of rotation 3
+                                {0, 0, 1, 0},
+                                {0, 0, 1, 0},
+                                {0, 0, 1, 0},
+                                {0, 0, 1, 0},
+                        }
+                }
+        };
+
+        TC->tetrominos[TC->count++] = (struct Tetromino) {
+                .name = "Square Tetrimino", // Display Name!
+                .shape = {
+                        { // Rotation 1: rotation left of rotation 4
+                                {0, 0, 0, 0},
+                                {0, 1, 1, 0},
+                                {0, 1, 1, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 2: rotation left of rotation 1
+                                {0, 0, 0, 0},
+                                {0, 1, 1, 0},
+                                {0, 1, 1, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 3: rotation left of rotation 2
+                                {0, 0, 0, 0},
+                                {0, 1, 1, 0},
+                                {0, 1, 1, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 4: rotation left of rotation 3
+                                {0, 0, 0, 0},
+                                {0, 1, 1, 0},
+                                {0, 1, 1, 0},
+                                {0, 0, 0, 0},
+                        }
+                }
+        };
+
+        TC->tetrominos[TC->count++] = (struct Tetromino) {
+                .name = "Skew Tetrimino", // Display Name!
+                .shape = {
+                        { // Rotation 1: rotation left of rotation 4
+                                {0, 0, 0, 0},
+                                {0, 0, 1, 1},
+                                {0, 1, 1, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 2: rotation left of rotation 1
+                                {0, 1, 0, 0},
+                                {0, 1, 1, 0},
+                                {0, 0, 1, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 3: rotation left of rotation 2
+                                {0, 0, 0, 0},
+                                {0, 1, 1, 0},
+                                {1, 1, 0, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 4: rotation left of rotation 3
+                                {0, 0, 0, 0},
+                                {0, 1, 0, 0},
+                                {0, 1, 1, 0},
+                                {0, 0, 1, 0},
+                        }
+                }
+        };
+
+        TC->tetrominos[TC->count++] = (struct Tetromino) {
+                .name = "L Tetrimino", // Display Name!
+                .shape = {
+                        { // Rotation 1: rotation left of rotation 4
+                                {0, 0, 0, 0},
+                                {0, 1, 0, 0},
+                                {0, 1, 0, 0},
+                                {0, 1, 1, 0},
+                        },
+                        { // Rotation 2: rotation left of rotation 1
+                                {0, 0, 0, 0},
+                                {0, 0, 0, 1},
+                                {0, 1, 1, 1},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 3: rotation left of rotation 2
+                                {0, 1, 1, 0},
+                                {0, 0, 1, 0},
+                                {0, 0, 1, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 4: rotation left of rotation 3
+                                {0, 0, 0, 0},
+                                {1, 1, 1, 0},
+                                {1, 0, 0, 0},
+                                {0, 0, 0, 0},
+                        }
+                }
+        };
+
+
+        TC->tetrominos[TC->count++] = (struct Tetromino) {
+                .name = "T Tetrimino", // Display Name!
+                .shape = {
+                        { // Rotation 1: rotation left of rotation 4
+                                {0, 0, 0, 0},
+                                {0, 1, 1, 1},
+                                {0, 0, 1, 0},
+                                {0, 0, 1, 0},
+                        },
+                        { // Rotation 2: rotation left of rotation 1
+                                {0, 1, 0, 0},
+                                {0, 1, 1, 1},
+                                {0, 1, 0, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 3: rotation left of rotation 2
+                                {0, 1, 0, 0},
+                                {0, 1, 0, 0},
+                                {1, 1, 1, 0},
+                                {0, 0, 0, 0},
+                        },
+                        { // Rotation 4: rotation left of rotation 3
+                                {0, 0, 0, 0},
+                                {0, 0, 1, 0},
+                                {1, 1, 1, 0},
+                                {0, 0, 1, 0},
+                        }
+                }
+        };
+
+        for (size_t i = 0; i < TC->count; i++) {
+                buildCollisionRows(&TC->tetrominos[i]);
+        }
+}
+
+static void buildCollisionRows(struct Tetromino* T) {
+        for (int rotation = 0; rotation < 4; rotation++) {
+                const unsigned short (*shape)[4] = T->shape[rotation];
+                for (int row = 0; row < 4; row++) {
+                        PieceRowMask* mask = &T->collisionRows[rotation][row];
+                        memset(mask, 0, sizeof(*mask));
+                        mask->left = INT16_MAX;
+                        mask->right = -1;
+
+                        for (int col = 0; col < 4; col++) {
+                                if (!shape[row][col] || (row < 3 && shape[row + 1][col])) {
+                                        continue;
+                                }
+                                if (mask->left == INT16_MAX) {
+                                        mask->left = col * PARTICLE_COUNT_IN_BLOCK_COLUMN;
+                                }
+                                mask->right = (col + 1) * PARTICLE_COUNT_IN_BLOCK_COLUMN - 1;
+                                for (int px = col * PARTICLE_COUNT_IN_BLOCK_COLUMN; px <= mask->right; px++) {
+                                        int bit = px - mask->left;
+                                        mask->bits[bit >> 6] |= 1ull << (bit & 63);
+                                }
+                        }
+                }
+        }
+}
+
+static inline void CleanUpTetriminoCollection(TetrominoCollection* TC) {
+        if (TC->tetrominos != NULL) {
+                free(TC->tetrominos);
+        }
+}
+
+static void destroyCurrentTetromino(GameData* GD) {
+        TetrominoData *TD = &GD->currentTetromino;
+        const unsigned short (*shape)[4] = TD->shape->shape[TD->rotation];
+
+        ColorCode color = TD->color;
+        int start_x = (int)TD->x - GAME_POS_X;
+        int start_y = (int)TD->y - GAME_POS_Y;
+
+
+        // Loop through 4x4 grid of current tetromino
+        for (int row = 0; row < 4; row++) {
+                for (int col = 0; col < 4; col++) {
+                        if (shape[row][col] == 0) continue;
+
+                        // Calculate base position for this block within the tetromino
+                        int block_base_x = start_x + col * PARTICLE_COUNT_IN_BLOCK_COLUMN;
+                        int block_base_y = start_y + row * PARTICLE_COUNT_IN_BLOCK_ROW;
+
+                        for (int y_offset = 0; y_offset < PARTICLE_COUNT_IN_BLOCK_ROW; y_offset++) {
+                                int grid_y = block_base_y + y_offset;
+
+                                // Check if within vertical bounds
+                                if (grid_y < 0 || grid_y >= GD->config.height) {
+                                        continue;
+                                }
+
+                                for (int x_offset = 0; x_offset < PARTICLE_COUNT_IN_BLOCK_COLUMN; x_offset++) {
+                                        int grid_x = block_base_x + x_offset;
+
+                                        // Check if within horizontal bounds
+                                        if (grid_x < 0 || grid_x >= GD->config.width) {
+                                                continue;
+                                        }
+
+                                        // Place the color in the grid
+                                        setCell(GD, grid_y, grid_x, color);
+                                }
+                        }
+                }
+        }
+
+        GD->currentTetromino = GD->nextTetromino;
+        GD->currentTetromino.velY = 0;
+        GD->currentTetromino.x = 0;
+        GD->currentTetromino.y = 0;
+        SimRect rect = sim_tetrominoBounds(&GD->currentTetromino);
+        GD->currentTetromino.x = GAME_POS_X + (GD->config.width - rect.w) * 0.5f - rect.x;
+        GD->currentTetromino.y = GAME_POS_Y - rect.h;
+
+        // Initialize new next tetromino
+        InitializeTetriminoData(&GD->rng, &GD->tetrominoCollection, &GD->nextTetromino);
+        rect = sim_tetrominoBounds(&GD->nextTetromino);
+        GD->nextTetromino.x = INFO_PANEL_X + (INFO_PANEL_WIDTH - rect.w) * 0.5f - rect.x;
+        GD->nextTetromino.y = INFO_PANEL_Y + (INFO_PANEL_HEIGHT) * 0.05f;
+}
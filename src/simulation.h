@@ -0,0 +1,265 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+// Sand simulation core: everything needed to play the game without a window.
+// No SDL in here so it can be linked into headless tools (see `make sim`).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "rng.h"
+#include "workpool.h"
+
+typedef enum {
+        COLOR_RED = 0,
+        COLOR_GREEN,
+        COLOR_BLUE,
+        COLOR_YELLOW,
+
+        COLOR_COUNT,
+
+        COLOR_DELETE_MARKED_SAND,
+
+        COLOR_BORDER,
+        COLOR_BACKGROUND, // Background color
+        COLOR_SAND,
+
+        COLOR_NONE, // Special Type!
+} ColorCode;
+
+// Pixel columns of one block row of a piece, as grid bits. Wide enough for 4 blocks at any SCALE_FACTOR
+#define PIECE_MASK_WORDS ((4 * PARTICLE_COUNT_IN_BLOCK_COLUMN + 63) / 64)
+
+typedef struct {
+        uint64_t bits[PIECE_MASK_WORDS]; // Bit 0 is pixel column `left` of the piece
+        int16_t left, right; // Pixel columns from the piece's x, inclusive. right < left: nothing to test
+} PieceRowMask;
+
+struct Tetromino {
+        // This is constant structure for defining the shapes of tetromino: L Shape, Square Shape, Line, Z Shape...
+        // A tetromino is a geometric shape composed of four connected squares
+        // 4 different rotation options
+        unsigned short shape[4][4][4];
+        char name[32]; // Optional?
+
+        // Per rotation and block row: the blocks with nothing of the piece below them, the only ones
+        // that can land on something. Built once with the collection, see checkTetrominoCollision
+        PieceRowMask collisionRows[4][4];
+};
+typedef struct {
+        struct Tetromino* tetrominos;
+        size_t capacity;
+        size_t count;
+} TetrominoCollection;
+
+typedef struct {
+        const struct Tetromino *shape;
+        uint8_t rotation; // 0–3
+        float x, y; // position of topleft block's topleft!
+        float velY;
+        ColorCode color;
+
+        // SandBlock sandBlock[4]; // 4 Blocks in a tetrimino
+} TetrominoData;
+
+// Playfield size, picked at sim_init. Everything sized by it is on the heap, so any size
+// works without touching the stack (see sim_defaultConfig for the one the game is laid out for)
+typedef struct {
+        int width, height; // Grid cells
+} SimConfig;
+
+#define SIM_MIN_WIDTH (4 * PARTICLE_COUNT_IN_BLOCK_COLUMN) // A lying line piece has to fit
+#define SIM_MIN_HEIGHT (4 * PARTICLE_COUNT_IN_BLOCK_ROW + 2)
+#define SIM_MAX_SIZE 4096 // Cell coordinates and per row/column counts are 16 bit
+
+// Bitplanes: one bit per cell, 64 cells per word, bit x of a row is column x
+#define GRID_ROW_WORDS(width) (((width) + 63) / 64)
+#define GRID_BIT_WORD(x) ((x) >> 6)
+#define GRID_BIT_MASK(x) (1ull << ((x) & 63))
+
+// Changed rows for the renderer, one bit per grid row
+#define DIRTY_ROW_WORDS(height) (((height) + 63) / 64)
+
+// Sand is stepped in CHUNK_SIZE x CHUNK_SIZE chunks, settled chunks fall asleep and cost nothing
+#define CHUNK_SIZE 16
+#define CHUNK_COUNT(cells) (((cells) + CHUNK_SIZE - 1) / CHUNK_SIZE)
+
+typedef struct {
+        int16_t x0, y0, x1, y1; // Grid cells, inclusive. Empty when x0 > x1
+} ChunkRect;
+
+typedef struct {
+        bool awake; // Has cells to visit this step
+        ChunkRect dirty; // Cells to visit this step
+        ChunkRect nextDirty; // Collected while stepping / between steps for the next step
+} SandChunk;
+
+// The parallel sand step works on vertical stripes of whole chunks: even stripes first, then odd.
+// Grains only move one column sideways, so stripes of the same parity never touch the same
+// cells or chunks. The layout doesn't depend on the thread count, neither do the results:
+// the serial stepper runs the same stripes in the same order on the calling thread
+#define SAND_STRIPE_WIDTH (2 * CHUNK_SIZE)
+#define SAND_STRIPE_COUNT(width) (((width) + SAND_STRIPE_WIDTH - 1) / SAND_STRIPE_WIDTH)
+
+typedef enum {
+        SIM_STEPPER_SERIAL, // Stripes one after the other on the calling thread
+        SIM_STEPPER_STRIPES, // Stripes spread over the worker pool, same results
+} SimStepper;
+
+// Horizontal stretch of same colored sand in one row, node of the clearance union-find
+typedef struct {
+        int16_t x0, x1; // inclusive
+        int16_t y;
+        uint8_t color;
+        uint8_t flags; // Which walls the region touches, only valid on the root
+        int parent;
+} SandRun;
+
+// Timed effects, advanced by sim_step's dt like everything else so replays and snapshots see them.
+// Any number of them can run side by side, same kind too
+typedef enum {
+        SIM_EFFECT_CLEAR_HITSTOP, // Sand and gravity hold still for a moment after a clear, the controls don't
+        SIM_EFFECT_CLEAR_FLASH, // Only drawn: the board lights up and fades out
+
+        SIM_EFFECT_KIND_COUNT,
+} SimEffectKind;
+
+typedef struct {
+        SimEffectKind kind;
+        float elapsed;
+        float duration;
+} SimEffect;
+
+#define SIM_MAX_EFFECTS 8
+
+typedef struct {
+        // Data on all things needed for game to function
+        unsigned score;
+
+        SimConfig config; // Grid size, fixed from sim_init on
+        int rowWords; // GRID_ROW_WORDS(width), words per bitplane row
+        int chunksX, chunksY;
+        int stripes; // SAND_STRIPE_COUNT(width)
+
+        // Grid sized arrays, all carved out of gridMemory, each on its own cache line
+        void* gridMemory;
+        uint8_t* colorGrid; // Color code of every cell (After blocks converted to sand), height rows of width, see sim_row
+        uint64_t* occupancy; // rowWords per row. Bit set for every cell that isn't COLOR_NONE, always in sync
+        uint64_t* colorPlanes[COLOR_COUNT]; // Bit per cell of that color, laid out like occupancy. Only built when needed
+        int16_t* columnTop; // First non-empty row of every column, height when empty. Always in sync
+        uint64_t* removedPlane; // Scratch: cells the last removal of marked sand cleared
+        SandRun* runs; // Scratch for sandClearance, one per cell
+        SandChunk* chunks; // chunksY rows of chunksX
+        uint16_t* markedInRow; // Cells currently COLOR_DELETE_MARKED_SAND, per row
+        uint64_t* dirtyRows; // DIRTY_ROW_WORDS(height): rows written since the renderer last took them
+        SimRng* stripeRng; // Own random stream per stripe, split off rng on reset
+        uint16_t* colorColumnCount[COLOR_COUNT]; // Cells of each color per column
+        struct SandStepper* steppers; // One per stripe, reused every step
+
+        TetrominoCollection tetrominoCollection; // Total Tetromino type in game collection!
+
+        int awakeChunks; // Chunks stepped by the last sand step
+        int markedSandCount; // Cells currently COLOR_DELETE_MARKED_SAND
+
+        SimStepper stepper;
+        WorkPool* pool; // Only for SIM_STEPPER_STRIPES, NULL when running on one thread
+        SimRng rng; // Pieces, and the stripes' streams on reset. Seeded once in sim_init
+        bool simdFall; // SSE2 kernel for straight down falls, on when built for it. Off gives the same results, slower
+        const struct SandKernels* kernels; // Hot loops specialized for this size, NULL when it isn't one of SIM_KERNEL_SIZES
+        bool sizedKernels; // Use them, on by default. Off runs the any size loops: same results, slower
+
+        // Clearance bookkeeping, kept in sync by every grid write
+        int colorColumnsCovered[COLOR_COUNT]; // Columns holding at least one cell of that color
+        unsigned clearanceDirtyColors; // Colors that gained cells since the last clearance check
+
+        // Timers, only advanced by sim_step's dt so the same inputs always replay the same game
+        float sandAccumulator; // Time not yet spent on sand sub-steps
+        float removalTimer; // How long marked sand has been waiting to be removed
+        SimEffect effects[SIM_MAX_EFFECTS]; // Running ones, oldest first
+        int effectCount;
+
+        TetrominoData currentTetromino;
+        TetrominoData ghostTetromino;
+        TetrominoData nextTetromino;
+
+        bool gameStarted;
+        bool gamePaused;
+        bool gameOver;
+        bool sandRemoveTrigger;
+} GameData;
+
+// Same layout as SDL_Rect so the renderer can use it directly
+typedef struct {
+        int x, y, w, h;
+} SimRect;
+
+// Input for one sim_step, OR-ed together.
+// LEFT/RIGHT are "held" and scaled by dt, the rest are one-shot presses
+typedef enum {
+        SIM_INPUT_NONE = 0,
+        SIM_INPUT_LEFT = 1 << 0,
+        SIM_INPUT_RIGHT = 1 << 1,
+        SIM_INPUT_ROTATE_CW = 1 << 2,
+        SIM_INPUT_ROTATE_CCW = 1 << 3,
+        SIM_INPUT_HARD_DROP = 1 << 4,
+        SIM_INPUT_PAUSE = 1 << 5, // Toggles pause
+        SIM_INPUT_START = 1 << 6, // Starts a new game when not playing
+} SimCommand;
+typedef uint32_t SimInput;
+
+// What happened during a sim_step, so the front end can play sounds, post scores...
+typedef enum {
+        SIM_EVENT_NONE = 0,
+        SIM_EVENT_STARTED = 1 << 0,
+        SIM_EVENT_PIECE_LOCKED = 1 << 1,
+        SIM_EVENT_SAND_CLEARED = 1 << 2,
+        SIM_EVENT_GAME_OVER = 1 << 3,
+} SimEvent;
+typedef uint32_t SimEvents;
+
+// The size the game's screen layout is made for: GAME_WIDTH x GAME_HEIGHT
+SimConfig sim_defaultConfig(void);
+// "WxH", as the tools take it on the command line. False on anything else
+bool sim_parseConfig(const char* text, SimConfig* config);
+// One time setup, game is left in the "not started" state. Same size, seed and inputs: same game
+bool sim_init(GameData*, SimConfig config, uint64_t seed);
+// Fresh board, new pieces, score 0
+void sim_reset(GameData*);
+// Apply input then advance the simulation by dt seconds
+SimEvents sim_step(GameData*, SimInput input, float dt); // dt: SIM_TICK_SECONDS in the game
+void sim_cleanup(GameData*);
+// Picks how sand is stepped, threads <= 0 means one per core, never more than half the stripes.
+// Can be changed between any two steps, the game plays out the same with any of them
+bool sim_setStepper(GameData*, SimStepper, int threads);
+// Call after writing colorGrid directly (tools, benchmarks) to rebuild the bookkeeping
+void sim_syncGrid(GameData*);
+// FNV-1a of the sand, same hash means same board. For replays and regression runs
+uint64_t sim_hashGrid(const GameData*);
+
+// Hands the changed rows over to the renderer (DIRTY_ROW_WORDS(height) words) and starts collecting again.
+// Rows holding marked sand are always included, their color changes every frame
+void sim_takeDirtyRows(GameData*, uint64_t* rows);
+
+// Row y of the grid, config.width cells
+static inline uint8_t* sim_row(const GameData* GD, int y) {
+        return GD->colorGrid + (size_t) y * GD->config.width;
+}
+
+SimRect sim_tetrominoBounds(const TetrominoData*);
+// Starts a timed effect, false when SIM_MAX_EFFECTS are already running
+bool sim_startEffect(GameData*, SimEffectKind, float duration);
+// How far along the newest running effect of that kind is, 0 to 1, or -1 when none is running
+float sim_effectProgress(const GameData*, SimEffectKind);
+
+// Where the piece comes to rest dropped straight down from where it is: the ghost's y.
+// Starts from the column height map so it costs a few collision tests, fine for placement searches too
+float sim_dropY(const GameData*, const TetrominoData*);
+
+// Single pieces of sim_step, for benchmarks and tools
+bool sim_stepSand(GameData*); // One sand sub-step, true if marked sand is waiting to be removed
+void sim_detectClearance(GameData*); // Marks every same color region touching both walls
+unsigned sim_removeMarked(GameData*); // Clears all marked sand right away, returns how many cells (the score it's worth)
+void sim_updateGhost(GameData*); // Drops the ghost piece below the current one
+
+#endif
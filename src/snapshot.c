@@ -0,0 +1,371 @@
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_RNG_BYTES (4 * 8 + 8 + 1)
+#define SNAPSHOT_PIECE_BYTES (1 + 1 + 1 + 3 * 4)
+#define SNAPSHOT_HEADER_BYTES (4 + 2 + 2 + 2)
+#define SNAPSHOT_CHUNK_BYTES (1 + 4 * 2)
+#define SNAPSHOT_EFFECT_BYTES (1 + 4 + 4)
+#define SNAPSHOT_FIXED_STATE_BYTES (4 + 1 + 4 + 4 + 1 + SIM_MAX_EFFECTS * SNAPSHOT_EFFECT_BYTES + SNAPSHOT_RNG_BYTES + 3 * SNAPSHOT_PIECE_BYTES)
+
+#define FLAG_STARTED (1 << 0)
+#define FLAG_PAUSED (1 << 1)
+#define FLAG_OVER (1 << 2)
+#define FLAG_REMOVE_TRIGGER (1 << 3)
+
+typedef struct {
+        uint8_t* at;
+        uint8_t* end;
+        bool ok; // False once something didn't fit, everything after is dropped
+} Writer;
+
+typedef struct {
+        const uint8_t* at;
+        const uint8_t* end;
+        bool ok; // False once we read past the end, reads after that return 0
+} Reader;
+
+// Everything, decoded before touching the GameData. The grid sized parts point into one block
+typedef struct {
+        unsigned score;
+        uint8_t flags;
+        float sandAccumulator;
+        float removalTimer;
+        SimEffect effects[SIM_MAX_EFFECTS];
+        int effectCount;
+        SimRng rng;
+        SimRng* stripeRng;
+        TetrominoData current, ghost, next;
+        ChunkRect* nextDirty;
+        uint8_t* grid;
+} SnapshotState;
+
+size_t snapshot_maxSize(const GameData* GD) {
+        size_t cells = (size_t) GD->config.width * GD->config.height;
+        return SNAPSHOT_HEADER_BYTES + SNAPSHOT_FIXED_STATE_BYTES + GD->stripes * SNAPSHOT_RNG_BYTES
+                + (size_t) GD->chunksX * GD->chunksY * SNAPSHOT_CHUNK_BYTES + 2 * cells;
+}
+
+static void putUint(Writer* W, uint64_t value, int bytes) {
+        if (W->end - W->at < bytes) {
+                W->ok = false;
+                return;
+        }
+        for (int i = 0; i < bytes; i++) {
+                *W->at++ = (uint8_t) (value >> (8 * i));
+        }
+}
+
+static void putFloat(Writer* W, float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        putUint(W, bits, 4);
+}
+
+// 7 bits per byte, high bit set while more follow
+static void putVarint(Writer* W, uint32_t value) {
+        while (value >= 0x80) {
+                putUint(W, (value & 0x7F) | 0x80, 1);
+                value >>= 7;
+        }
+        putUint(W, value, 1);
+}
+
+static uint64_t getUint(Reader* R, int bytes) {
+        if (R->end - R->at < bytes) {
+                R->ok = false;
+                return 0;
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) {
+                value |= (uint64_t) *R->at++ << (8 * i);
+        }
+        return value;
+}
+
+static float getFloat(Reader* R) {
+        uint32_t bits = (uint32_t) getUint(R, 4);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+}
+
+static uint32_t getVarint(Reader* R) {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+                uint64_t byte = getUint(R, 1);
+                value |= (uint32_t) (byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) return value;
+        }
+        R->ok = false;
+        return 0;
+}
+
+static void putRng(Writer* W, const SimRng* rng) {
+        for (int i = 0; i < 4; i++) {
+                putUint(W, rng->s[i], 8);
+        }
+        putUint(W, rng->bits, 8);
+        putUint(W, rng->bitsLeft, 1);
+}
+
+static void getRng(Reader* R, SimRng* rng) {
+        for (int i = 0; i < 4; i++) {
+                rng->s[i] = getUint(R, 8);
+        }
+        rng->bits = getUint(R, 8);
+        rng->bitsLeft = (int) getUint(R, 1);
+        if (rng->bitsLeft > 64) R->ok = false;
+}
+
+// Shape as its index in the collection, pointers don't survive a restart
+static void putPiece(Writer* W, const GameData* GD, const TetrominoData* TD) {
+        putUint(W, TD->shape - GD->tetrominoCollection.tetrominos, 1);
+        putUint(W, TD->rotation, 1);
+        putUint(W, TD->color, 1);
+        putFloat(W, TD->x);
+        putFloat(W, TD->y);
+        putFloat(W, TD->velY);
+}
+
+static void getPiece(Reader* R, const GameData* GD, TetrominoData* TD) {
+        size_t shape = getUint(R, 1);
+        TD->rotation = (uint8_t) getUint(R, 1);
+        TD->color = (ColorCode) getUint(R, 1);
+        TD->x = getFloat(R);
+        TD->y = getFloat(R);
+        TD->velY = getFloat(R);
+
+        if (shape >= GD->tetrominoCollection.count || TD->rotation > 3 || TD->color >= COLOR_COUNT) {
+                R->ok = false;
+                return;
+        }
+        TD->shape = &GD->tetrominoCollection.tetrominos[shape];
+}
+
+// Which cells the next sand step visits. Part of the state, not just a speedup: every blocked
+// grain that gets visited flips a coin, so waking more chunks would change the game from here on
+static void putChunk(Writer* W, const SandChunk* chunk) {
+        const ChunkRect* rect = &chunk->nextDirty;
+        bool empty = rect->x0 > rect->x1;
+        putUint(W, !empty, 1);
+        if (!empty) {
+                putUint(W, rect->x0, 2);
+                putUint(W, rect->y0, 2);
+                putUint(W, rect->x1, 2);
+                putUint(W, rect->y1, 2);
+        }
+}
+
+static void getChunk(Reader* R, const GameData* GD, ChunkRect* rect) {
+        *rect = (ChunkRect) { INT16_MAX, INT16_MAX, -1, -1 };
+        if (getUint(R, 1) == 0) {
+                return;
+        }
+        rect->x0 = (int16_t) getUint(R, 2);
+        rect->y0 = (int16_t) getUint(R, 2);
+        rect->x1 = (int16_t) getUint(R, 2);
+        rect->y1 = (int16_t) getUint(R, 2);
+        if (rect->x0 < 0 || rect->x0 > rect->x1 || rect->x1 >= GD->config.width || rect->y0 < 0 || rect->y0 > rect->y1 || rect->y1 >= GD->config.height) {
+                R->ok = false;
+        }
+}
+
+size_t snapshot_write(const GameData* GD, uint8_t* buffer, size_t capacity) {
+        Writer W = { .at = buffer, .end = buffer + capacity, .ok = true };
+
+        for (int i = 0; i < 4; i++) {
+                putUint(&W, SNAPSHOT_MAGIC[i], 1);
+        }
+        putUint(&W, SNAPSHOT_VERSION, 2);
+        putUint(&W, GD->config.width, 2);
+        putUint(&W, GD->config.height, 2);
+
+        uint8_t flags = (GD->gameStarted? FLAG_STARTED: 0) | (GD->gamePaused? FLAG_PAUSED: 0)
+                | (GD->gameOver? FLAG_OVER: 0) | (GD->sandRemoveTrigger? FLAG_REMOVE_TRIGGER: 0);
+        putUint(&W, GD->score, 4);
+        putUint(&W, flags, 1);
+        putFloat(&W, GD->sandAccumulator);
+        putFloat(&W, GD->removalTimer);
+        putUint(&W, GD->effectCount, 1);
+        for (int i = 0; i < GD->effectCount; i++) {
+                putUint(&W, GD->effects[i].kind, 1);
+                putFloat(&W, GD->effects[i].elapsed);
+                putFloat(&W, GD->effects[i].duration);
+        }
+        putRng(&W, &GD->rng);
+        for (int stripe = 0; stripe < GD->stripes; stripe++) {
+                putRng(&W, &GD->stripeRng[stripe]);
+        }
+        putPiece(&W, GD, &GD->currentTetromino);
+        putPiece(&W, GD, &GD->ghostTetromino);
+        putPiece(&W, GD, &GD->nextTetromino);
+        for (int i = 0; i < GD->chunksX * GD->chunksY; i++) {
+                putChunk(&W, &GD->chunks[i]);
+        }
+
+        // Runs may cross rows, a settled bottom is a handful of them
+        const uint8_t* cell = GD->colorGrid;
+        const uint8_t* last = cell + (size_t) GD->config.width * GD->config.height;
+        while (cell < last && W.ok) {
+                const uint8_t* run = cell;
+                uint64_t same = *cell * 0x0101010101010101ull;
+                uint64_t word;
+                while (last - run >= 8 && (memcpy(&word, run, 8), word == same)) run += 8;
+                while (run < last && *run == *cell) run++;
+                putUint(&W, *cell, 1);
+                putVarint(&W, (uint32_t) (run - cell));
+                cell = run;
+        }
+
+        return W.ok? (size_t) (W.at - buffer): 0;
+}
+
+bool snapshot_read(GameData* GD, const uint8_t* buffer, size_t size) {
+        Reader R = { .at = buffer, .end = buffer + size, .ok = true };
+
+        if (size < SNAPSHOT_HEADER_BYTES || memcmp(buffer, SNAPSHOT_MAGIC, 4) != 0) {
+                fprintf(stderr, "Snapshot: not a snapshot\n");
+                return false;
+        }
+        R.at += 4;
+        unsigned version = (unsigned) getUint(&R, 2);
+        unsigned width = (unsigned) getUint(&R, 2);
+        unsigned height = (unsigned) getUint(&R, 2);
+        if (version != SNAPSHOT_VERSION || (int) width != GD->config.width || (int) height != GD->config.height) {
+                fprintf(stderr, "Snapshot: version %u of a %ux%u grid, this game reads version %d of %dx%d\n",
+                        version, width, height, SNAPSHOT_VERSION, GD->config.width, GD->config.height);
+                return false;
+        }
+
+        int chunkCount = GD->chunksX * GD->chunksY;
+        size_t cells = (size_t) GD->config.width * GD->config.height;
+        SnapshotState state;
+        void* scratch = malloc(sizeof(SimRng) * GD->stripes + sizeof(ChunkRect) * chunkCount + cells);
+        if (scratch == NULL) {
+                fprintf(stderr, "Snapshot: out of memory\n");
+                return false;
+        }
+        state.stripeRng = scratch;
+        state.nextDirty = (ChunkRect*) (state.stripeRng + GD->stripes);
+        state.grid = (uint8_t*) (state.nextDirty + chunkCount);
+
+        state.score = (unsigned) getUint(&R, 4);
+        state.flags = (uint8_t) getUint(&R, 1);
+        state.sandAccumulator = getFloat(&R);
+        state.removalTimer = getFloat(&R);
+        state.effectCount = (int) getUint(&R, 1);
+        if (state.effectCount > SIM_MAX_EFFECTS) {
+                R.ok = false;
+                state.effectCount = 0;
+        }
+        for (int i = 0; i < state.effectCount; i++) {
+                unsigned kind = (unsigned) getUint(&R, 1);
+                if (kind >= SIM_EFFECT_KIND_COUNT) R.ok = false;
+                state.effects[i].kind = (SimEffectKind) kind;
+                state.effects[i].elapsed = getFloat(&R);
+                state.effects[i].duration = getFloat(&R);
+        }
+        getRng(&R, &state.rng);
+        for (int stripe = 0; stripe < GD->stripes; stripe++) {
+                getRng(&R, &state.stripeRng[stripe]);
+        }
+        getPiece(&R, GD, &state.current);
+        getPiece(&R, GD, &state.ghost);
+        getPiece(&R, GD, &state.next);
+        for (int i = 0; i < chunkCount; i++) {
+                getChunk(&R, GD, &state.nextDirty[i]);
+        }
+
+        // Decoded aside first so a bad snapshot can't leave half a board behind
+        size_t filled = 0;
+        while (filled < cells && R.ok) {
+                uint8_t color = (uint8_t) getUint(&R, 1);
+                uint32_t length = getVarint(&R);
+                bool sand = color < COLOR_COUNT || color == COLOR_DELETE_MARKED_SAND || color == COLOR_NONE; // What the grid can hold
+                if (!sand || length == 0 || length > cells - filled) {
+                        R.ok = false;
+                        break;
+                }
+                memset(state.grid + filled, color, length);
+                filled += length;
+        }
+        if (!R.ok || R.at != R.end) {
+                fprintf(stderr, "Snapshot: damaged or truncated\n");
+                free(scratch);
+                return false;
+        }
+
+        GD->score = state.score;
+        GD->gameStarted = state.flags & FLAG_STARTED;
+        GD->gamePaused = state.flags & FLAG_PAUSED;
+        GD->gameOver = state.flags & FLAG_OVER;
+        GD->sandRemoveTrigger = state.flags & FLAG_REMOVE_TRIGGER;
+        GD->sandAccumulator = state.sandAccumulator;
+        GD->removalTimer = state.removalTimer;
+        memcpy(GD->effects, state.effects, sizeof(SimEffect) * state.effectCount);
+        GD->effectCount = state.effectCount;
+        GD->rng = state.rng;
+        memcpy(GD->stripeRng, state.stripeRng, sizeof(SimRng) * GD->stripes);
+        GD->currentTetromino = state.current;
+        GD->ghostTetromino = state.ghost;
+        GD->nextTetromino = state.next;
+
+        // The rest of the bookkeeping is derived from the grid
+        memcpy(GD->colorGrid, state.grid, cells);
+        sim_syncGrid(GD);
+        for (int i = 0; i < chunkCount; i++) {
+                GD->chunks[i].nextDirty = state.nextDirty[i];
+        }
+        free(scratch);
+        return true;
+}
+
+bool snapshot_save(const GameData* GD, const char* path) {
+        size_t capacity = snapshot_maxSize(GD);
+        uint8_t* buffer = malloc(capacity);
+        if (buffer == NULL) {
+                fprintf(stderr, "Snapshot: out of memory\n");
+                return false;
+        }
+        size_t size = snapshot_write(GD, buffer, capacity);
+
+        FILE* file = fopen(path, "wb");
+        if (file == NULL) {
+                fprintf(stderr, "Snapshot: could not write %s\n", path);
+                free(buffer);
+                return false;
+        }
+        bool ok = fwrite(buffer, 1, size, file) == size;
+        if (fclose(file) != 0) ok = false;
+        if (!ok) {
+                fprintf(stderr, "Snapshot: error while writing %s\n", path);
+        }
+        free(buffer);
+        return ok;
+}
+
+bool snapshot_load(GameData* GD, const char* path) {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+                fprintf(stderr, "Snapshot: could not open %s\n", path);
+                return false;
+        }
+
+        // One byte of slack so an oversized file shows up as trailing data instead of being cut
+        size_t capacity = snapshot_maxSize(GD) + 1;
+        uint8_t* buffer = malloc(capacity);
+        if (buffer == NULL) {
+                fprintf(stderr, "Snapshot: out of memory\n");
+                fclose(file);
+                return false;
+        }
+        size_t size = fread(buffer, 1, capacity, file);
+        fclose(file);
+
+        bool ok = snapshot_read(GD, buffer, size);
+        free(buffer);
+        return ok;
+}
@@ -0,0 +1,32 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+// Whole game state: grid, pieces, score, flags, random streams, timers, running effects and the
+// chunks the next sand step will visit.
+// Restoring a snapshot into any sim_init'ed GameData continues the exact same game, so it
+// works for suspend/resume, for benchmark boards and for forking a state to look ahead.
+//
+// Layout, little endian: "STSN", u16 version, u16 grid width, u16 grid height, then the state
+// (see snapshot_write) and the grid as runs of u8 color + varint length, row by row.
+// Settled sand is long runs: an empty board is ~1.5KB, a half full one ~7KB
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "simulation.h"
+
+#define SNAPSHOT_MAGIC "STSN"
+#define SNAPSHOT_VERSION 2 // 2: running effects
+
+// Worst case size for GD's grid, every cell a run of its own
+size_t snapshot_maxSize(const GameData*);
+
+// Bytes written, 0 if capacity is too small
+size_t snapshot_write(const GameData*, uint8_t* buffer, size_t capacity);
+// GD must come from sim_init with the snapshot's grid size. Leaves GD untouched when the data is bad
+bool snapshot_read(GameData*, const uint8_t* buffer, size_t size);
+
+bool snapshot_save(const GameData*, const char* path);
+bool snapshot_load(GameData*, const char* path);
+
+#endif
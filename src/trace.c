@@ -0,0 +1,184 @@
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+#include "trace.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_MAX_THREADS 64 // Rings are never reused, threads past this go unrecorded
+
+typedef struct {
+        const char* name;
+        uint64_t start, end;
+} TraceEvent;
+
+// One writer, its own thread. count only grows, event i lives in slot i % TRACE_RING_EVENTS
+typedef struct {
+        TraceEvent events[TRACE_RING_EVENTS];
+        atomic_ullong count;
+        char name[32];
+} TraceRing;
+
+bool traceRecording = TRACE_ZONES;
+
+static TraceRing* _Atomic rings[TRACE_MAX_THREADS]; // NULL until its thread made it
+static atomic_int ringCount;
+static _Thread_local TraceRing* threadRing;
+static _Thread_local bool threadUntraced; // Out of rings or memory, don't retry every zone
+static _Thread_local char threadName[32]; // Kept until the thread's first zone makes its ring
+
+uint64_t trace_now(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static TraceRing* ownRing(void) {
+        if (threadRing != NULL || threadUntraced) {
+                return threadRing;
+        }
+
+        int index = atomic_fetch_add(&ringCount, 1);
+        TraceRing* ring = (index < TRACE_MAX_THREADS)? calloc(1, sizeof(TraceRing)): NULL;
+        if (ring == NULL) {
+                fprintf(stderr, "Trace: no ring for this thread, its zones are dropped\n");
+                threadUntraced = true;
+                return NULL;
+        }
+        if (threadName[0] != '\0') {
+                memcpy(ring->name, threadName, sizeof(ring->name));
+        } else {
+                snprintf(ring->name, sizeof(ring->name), "thread %d", index);
+        }
+        atomic_init(&ring->count, 0);
+        atomic_store_explicit(&rings[index], ring, memory_order_release);
+        threadRing = ring;
+        return ring;
+}
+
+void trace_record(const char* name, uint64_t start, uint64_t end) {
+        TraceRing* ring = ownRing();
+        if (ring == NULL) {
+                return;
+        }
+
+        uint64_t count = atomic_load_explicit(&ring->count, memory_order_relaxed);
+        ring->events[count % TRACE_RING_EVENTS] = (TraceEvent) { name, start, end };
+        atomic_store_explicit(&ring->count, count + 1, memory_order_release);
+}
+
+void trace_setRecording(bool on) {
+        traceRecording = TRACE_ZONES && on;
+}
+
+// Only stored: a thread gets its ring with its first zone, threads that never record one cost nothing
+void trace_setThreadName(const char* name) {
+        snprintf(threadName, sizeof(threadName), "%s", name);
+        if (threadRing != NULL) {
+                memcpy(threadRing->name, threadName, sizeof(threadRing->name));
+        }
+}
+
+// Names are literals from our own code, escaping is just for safety
+static void putJsonString(FILE* file, const char* text) {
+        fputc('"', file);
+        for (; *text; text++) {
+                if (*text == '"' || *text == '\\') {
+                        fputc('\\', file);
+                }
+                fputc((unsigned char) *text < 0x20? '?': *text, file);
+        }
+        fputc('"', file);
+}
+
+// Events of one ring that were surely not overwritten while copying, in the order they ended
+static int copyRing(TraceRing* ring, TraceEvent* out) {
+        uint64_t end = atomic_load_explicit(&ring->count, memory_order_acquire);
+        uint64_t begin = (end > TRACE_RING_EVENTS)? end - TRACE_RING_EVENTS: 0;
+        for (uint64_t i = begin; i < end; i++) {
+                out[i - begin] = ring->events[i % TRACE_RING_EVENTS];
+        }
+
+        // The writer may have lapped the start meanwhile: slot of event i is reused by i + TRACE_RING_EVENTS
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t now = atomic_load_explicit(&ring->count, memory_order_relaxed);
+        uint64_t safe = (now >= TRACE_RING_EVENTS)? now - TRACE_RING_EVENTS + 1: 0;
+        if (safe > begin) {
+                uint64_t skip = (safe < end)? safe - begin: end - begin;
+                memmove(out, out + skip, sizeof(TraceEvent) * (end - begin - skip));
+                begin += skip;
+        }
+        return (int) (end - begin);
+}
+
+bool trace_dump(const char* path) {
+        int threads = atomic_load(&ringCount);
+        if (threads > TRACE_MAX_THREADS) threads = TRACE_MAX_THREADS;
+
+        // Copied out first, so the timestamps can start at the oldest zone anywhere
+        TraceEvent* events = malloc(sizeof(TraceEvent) * TRACE_RING_EVENTS * (threads > 0? threads: 1));
+        if (events == NULL) {
+                fprintf(stderr, "Trace: out of memory\n");
+                return false;
+        }
+        int counts[TRACE_MAX_THREADS];
+        uint64_t origin = UINT64_MAX;
+        for (int t = 0; t < threads; t++) {
+                TraceRing* ring = atomic_load_explicit(&rings[t], memory_order_acquire);
+                counts[t] = (ring != NULL)? copyRing(ring, events + (size_t) t * TRACE_RING_EVENTS): 0;
+                for (int i = 0; i < counts[t]; i++) {
+                        uint64_t start = events[(size_t) t * TRACE_RING_EVENTS + i].start; // Stored as they end, an outer zone comes after its insides
+                        if (start < origin) origin = start;
+                }
+        }
+
+        FILE* file = fopen(path, "w");
+        if (file == NULL) {
+                fprintf(stderr, "Trace: can't write %s\n", path);
+                free(events);
+                return false;
+        }
+
+        // Times in us, like the format wants
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (int t = 0; t < threads; t++) {
+                TraceRing* ring = atomic_load_explicit(&rings[t], memory_order_acquire);
+                if (ring == NULL) {
+                        continue;
+                }
+
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first? "": ",\n", t);
+                putJsonString(file, ring->name);
+                fprintf(file, "}}");
+                first = false;
+
+                const TraceEvent* ringEvents = events + (size_t) t * TRACE_RING_EVENTS;
+                for (int i = 0; i < counts[t]; i++) {
+                        const TraceEvent* event = &ringEvents[i];
+                        fprintf(file, ",\n{\"name\":");
+                        putJsonString(file, event->name);
+                        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                                t, (event->start - origin) / 1000.0, (event->end - event->start) / 1000.0);
+                }
+        }
+        fprintf(file, "\n]}\n");
+        free(events);
+
+        if (fclose(file) != 0) {
+                fprintf(stderr, "Trace: writing %s failed\n", path);
+                return false;
+        }
+        return true;
+}
+
+void trace_cleanup(void) {
+        int threads = atomic_load(&ringCount);
+        if (threads > TRACE_MAX_THREADS) threads = TRACE_MAX_THREADS;
+        for (int t = 0; t < threads; t++) {
+                free(atomic_exchange(&rings[t], NULL));
+        }
+        atomic_store(&ringCount, 0);
+        threadRing = NULL; // Only the calling thread's, the others are gone by now
+}
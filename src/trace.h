@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Scoped timing zones for finding where a slow frame went.
+// Every thread records finished zones into its own ring, trace_dump writes what the rings
+// still hold as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev).
+//
+//         TraceZone zone = trace_begin("game_update");
+//         ...
+//         trace_end(zone);
+//
+// Names must outlive the trace, string literals. With TRACE_ZONES 0 all of it compiles away,
+// while tracing is off a zone costs one load and a branch.
+
+typedef struct {
+        const char* name; // NULL: not recording
+        uint64_t start; // ns
+} TraceZone;
+
+extern bool traceRecording; // Use trace_setRecording
+
+uint64_t trace_now(void);
+void trace_record(const char* name, uint64_t start, uint64_t end);
+
+static inline TraceZone trace_begin(const char* name) {
+        if (!TRACE_ZONES || !traceRecording) {
+                return (TraceZone) { NULL, 0 };
+        }
+        return (TraceZone) { name, trace_now() };
+}
+
+static inline void trace_end(TraceZone zone) {
+        if (TRACE_ZONES && zone.name != NULL) {
+                trace_record(zone.name, zone.start, trace_now());
+        }
+}
+
+void trace_setRecording(bool on);
+// Shows up as the track name, copied. Threads without one are "thread N"
+void trace_setThreadName(const char* name);
+// Everything still in the rings, oldest first. The rings keep recording meanwhile
+bool trace_dump(const char* path);
+// Call once no thread records anymore
+void trace_cleanup(void);
+
+#endif
@@ -0,0 +1,147 @@
+#define _DEFAULT_SOURCE // sysconf
+#include "workpool.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct WorkPool {
+        pthread_t* workers; // Extra threads, the caller is the last one
+        int workerCount;
+
+        pthread_mutex_t lock;
+        pthread_cond_t wake; // Workers wait here for the next generation
+        pthread_cond_t finished; // Caller waits here for busy to reach 0
+        unsigned generation; // Bumped once per workpool_run
+        int busy; // Workers still inside the current generation
+        bool quit;
+
+        WorkFn fn;
+        void* ctx;
+        int jobs;
+        atomic_int nextJob;
+};
+
+// Grab jobs until there are none left, shared by the workers and the caller
+static void runJobs(WorkPool* pool) {
+        int job;
+        while ((job = atomic_fetch_add_explicit(&pool->nextJob, 1, memory_order_relaxed)) < pool->jobs) {
+                pool->fn(pool->ctx, job);
+        }
+}
+
+static void* workerMain(void* arg) {
+        WorkPool* pool = arg;
+        unsigned seen = 0;
+        trace_setThreadName("worker");
+
+        pthread_mutex_lock(&pool->lock);
+        for (;;) {
+                while (pool->generation == seen && !pool->quit) {
+                        pthread_cond_wait(&pool->wake, &pool->lock);
+                }
+                if (pool->quit) {
+                        break;
+                }
+                seen = pool->generation;
+                pthread_mutex_unlock(&pool->lock);
+
+                runJobs(pool);
+
+                pthread_mutex_lock(&pool->lock);
+                if (--pool->busy == 0) {
+                        pthread_cond_signal(&pool->finished);
+                }
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+}
+
+int workpool_cores(void) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        return (cores > 0)? (int) cores: 1;
+}
+
+WorkPool* workpool_create(int threads) {
+        if (threads <= 0) {
+                threads = workpool_cores();
+        }
+
+        WorkPool* pool = calloc(1, sizeof(WorkPool));
+        if (pool == NULL) {
+                return NULL;
+        }
+        pool->workers = calloc(threads, sizeof(pthread_t));
+        if (pool->workers == NULL) {
+                free(pool);
+                return NULL;
+        }
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->wake, NULL);
+        pthread_cond_init(&pool->finished, NULL);
+        atomic_init(&pool->nextJob, 0);
+
+        for (int i = 0; i < threads - 1; i++) {
+                if (pthread_create(&pool->workers[i], NULL, workerMain, pool) != 0) {
+                        fprintf(stderr, "Worker thread creation failed, running with %d threads\n", i + 1);
+                        break;
+                }
+                pool->workerCount++;
+        }
+        return pool;
+}
+
+int workpool_threads(const WorkPool* pool) {
+        return (pool == NULL)? 1: pool->workerCount + 1;
+}
+
+void workpool_run(WorkPool* pool, int jobs, WorkFn fn, void* ctx) {
+        // Nothing to share: skip the wake up round trip
+        if (pool == NULL || pool->workerCount == 0 || jobs <= 1) {
+                for (int job = 0; job < jobs; job++) {
+                        fn(ctx, job);
+                }
+                return;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->fn = fn;
+        pool->ctx = ctx;
+        pool->jobs = jobs;
+        atomic_store_explicit(&pool->nextJob, 0, memory_order_relaxed);
+        pool->busy = pool->workerCount;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+
+        runJobs(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->busy > 0) {
+                pthread_cond_wait(&pool->finished, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+}
+
+void workpool_destroy(WorkPool* pool) {
+        if (pool == NULL) {
+                return;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->quit = true;
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (int i = 0; i < pool->workerCount; i++) {
+                pthread_join(pool->workers[i], NULL);
+        }
+        pthread_cond_destroy(&pool->finished);
+        pthread_cond_destroy(&pool->wake);
+        pthread_mutex_destroy(&pool->lock);
+        free(pool->workers);
+        free(pool);
+}
@@ -0,0 +1,19 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+// Persistent worker threads for splitting one piece of work into independent jobs.
+// The calling thread works too, so a pool of 1 thread is just a plain loop.
+
+typedef void (*WorkFn)(void* ctx, int job);
+typedef struct WorkPool WorkPool;
+
+// threads counts the caller, <= 0 means one per core. NULL on failure
+WorkPool* workpool_create(int threads);
+int workpool_cores(void); // Online, at least 1
+int workpool_threads(const WorkPool*);
+// Runs fn(ctx, 0..jobs-1) spread over the pool and returns once all are done.
+// A NULL pool runs everything on the caller
+void workpool_run(WorkPool*, int jobs, WorkFn fn, void* ctx);
+void workpool_destroy(WorkPool*);
+
+#endif
@@ -0,0 +1,140 @@
+// Headless driver for the sand simulation: no window, no audio, no frame limiter.
+// Plays random inputs as fast as the CPU allows, useful for load and regression runs.
+//
+// Usage: ./build/headless [--size WxH] [--trace out.json] [ticks] [seed] [threads] [out.replay]
+//   --size: grid cells, default is the game's GAME_WIDTH x GAME_HEIGHT
+//   --trace: record timing zones and write the last TRACE_RING_EVENTS of each thread as Chrome trace JSON
+//   threads: sand worker threads, 0 (default) is one per core, "serial" is the original single row scan
+//   out.replay: also record the run, ./build/playback must then end on the same grid hash
+
+#include "replay.h"
+#include "simulation.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double nowSeconds(void) {
+        struct timespec ts;
+        timespec_get(&ts, TIME_UTC);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Something that roughly looks like a player: hold a direction for a while, rotate and drop sometimes
+static SimInput randomInput(SimRng* rng) {
+        static SimInput held = SIM_INPUT_NONE;
+        static int holdFrames = 0;
+
+        if (holdFrames-- <= 0) {
+                int r = rng_below(rng, 3);
+                held = (r == 0)? SIM_INPUT_LEFT: (r == 1)? SIM_INPUT_RIGHT: SIM_INPUT_NONE;
+                holdFrames = rng_below(rng, 30);
+        }
+
+        SimInput input = held;
+        if (rng_below(rng, 40) == 0) input |= SIM_INPUT_ROTATE_CW;
+        if (rng_below(rng, 120) == 0) input |= SIM_INPUT_HARD_DROP;
+        return input;
+}
+
+int main(int argc, char** argv) {
+        SimConfig config = sim_defaultConfig();
+        const char* tracePath = NULL;
+        while (argc > 2 && strncmp(argv[1], "--", 2) == 0) {
+                if (strcmp(argv[1], "--trace") == 0) {
+                        tracePath = argv[2];
+                } else if (strcmp(argv[1], "--size") != 0 || !sim_parseConfig(argv[2], &config)) {
+                        fprintf(stderr, "Usage: %s [--size WxH] [--trace out.json] [ticks] [seed] [threads] [out.replay]\n", argv[0]);
+                        return 1;
+                }
+                argv[2] = argv[0];
+                argv += 2;
+                argc -= 2;
+        }
+        trace_setRecording(tracePath != NULL);
+        trace_setThreadName("main");
+
+        long ticks = (argc > 1)? atol(argv[1]): 100000;
+        uint64_t seed = (argc > 2)? strtoull(argv[2], NULL, 10): 1;
+        SimRng inputRng; // The "player", separate from the game's own randomness
+        rng_seed(&inputRng, ~seed);
+
+        GameData* GD = malloc(sizeof(GameData));
+        if (GD == NULL || !sim_init(GD, config, seed)) {
+                fprintf(stderr, "Simulation Initialization Error!\n");
+                free(GD);
+                return 1;
+        }
+        if (argc > 3) {
+                bool serial = strcmp(argv[3], "serial") == 0;
+                if (!sim_setStepper(GD, serial? SIM_STEPPER_SERIAL: SIM_STEPPER_STRIPES, serial? 1: atoi(argv[3]))) {
+                        sim_cleanup(GD);
+                        free(GD);
+                        return 1;
+                }
+        }
+
+        Replay replay;
+        replay_init(&replay, config, seed, GD->stepper);
+        bool recording = argc > 4;
+
+        long games = 0, locks = 0, clears = 0;
+        unsigned bestScore = 0;
+
+        double start = nowSeconds();
+        for (long tick = 0; tick < ticks; tick++) {
+                SimInput input = randomInput(&inputRng);
+                if (GD->gameOver || GD->gameStarted == false) {
+                        input |= SIM_INPUT_START;
+                }
+                if (recording && !replay_record(&replay, input)) {
+                        fprintf(stderr, "Recording failed at tick %ld\n", tick);
+                        replay_free(&replay);
+                        sim_cleanup(GD);
+                        free(GD);
+                        return 1;
+                }
+
+                TraceZone zone = trace_begin("sim_step");
+                SimEvents events = sim_step(GD, input, SIM_TICK_SECONDS);
+                trace_end(zone);
+                if (events & SIM_EVENT_STARTED) games++;
+                if (events & SIM_EVENT_PIECE_LOCKED) locks++;
+                if (events & SIM_EVENT_SAND_CLEARED) clears++;
+                if (GD->score > bestScore) bestScore = GD->score;
+        }
+        double elapsed = nowSeconds() - start;
+
+        printf("grid: %dx%d, %s kernels\n", config.width, config.height, GD->kernels? "sized": "any size");
+        if (GD->stepper == SIM_STEPPER_SERIAL) {
+                printf("sand: %d stripes on the calling thread\n", GD->stripes);
+        } else {
+                printf("sand: %d stripes on %d threads\n", GD->stripes, workpool_threads(GD->pool));
+        }
+        printf("ticks: %ld in %.3fs (%.0f ticks/s, %.1fx realtime at %d ticks/s)\n",
+                ticks, elapsed, ticks / elapsed, ticks / elapsed / SIM_TICK_RATE, SIM_TICK_RATE);
+        printf("games: %ld, pieces locked: %ld, clears: %ld, best score: %u\n", games, locks, clears, bestScore);
+        printf("score: %u\n", GD->score);
+        printf("grid hash: %016llx\n", (unsigned long long) sim_hashGrid(GD));
+
+        if (recording) {
+                if (!replay_save(&replay, argv[4])) {
+                        return 1;
+                }
+                printf("recorded %ld ticks in %d runs to %s\n", replay.ticks, replay.runCount, argv[4]);
+                replay_free(&replay);
+        }
+
+        if (tracePath != NULL) {
+                if (!trace_dump(tracePath)) {
+                        return 1;
+                }
+                printf("trace written to %s\n", tracePath);
+        }
+
+        sim_cleanup(GD);
+        free(GD);
+        trace_cleanup();
+        return 0;
+}
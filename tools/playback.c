@@ -0,0 +1,73 @@
+// Replays a recorded game as fast as the CPU allows and prints where it ended up.
+// Same replay, same build: same score and grid hash, so a changed hash means the simulation changed.
+//
+// Usage: ./build/playback <file.replay> [threads]
+//   threads: sand worker threads for a stripes replay, 0 (default) is one per core. Doesn't change the result
+
+#include "replay.h"
+#include "simulation.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double nowSeconds(void) {
+        struct timespec ts;
+        timespec_get(&ts, TIME_UTC);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+        if (argc < 2) {
+                fprintf(stderr, "Usage: %s <file.replay> [threads]\n", argv[0]);
+                return 1;
+        }
+
+        Replay replay;
+        replay_init(&replay, sim_defaultConfig(), 0, SIM_STEPPER_STRIPES);
+        if (!replay_load(&replay, argv[1])) {
+                return 1;
+        }
+
+        GameData* GD = malloc(sizeof(GameData));
+        if (GD == NULL || !sim_init(GD, replay.config, replay.seed)) {
+                fprintf(stderr, "Simulation Initialization Error!\n");
+                free(GD);
+                replay_free(&replay);
+                return 1;
+        }
+        int threads = (argc > 2)? atoi(argv[2]): 0;
+        if (!sim_setStepper(GD, replay.stepper, replay.stepper == SIM_STEPPER_SERIAL? 1: threads)) {
+                sim_cleanup(GD);
+                free(GD);
+                replay_free(&replay);
+                return 1;
+        }
+
+        long games = 0, locks = 0, clears = 0;
+        float dt = 1.0f / replay.tickRate;
+
+        double start = nowSeconds();
+        for (int i = 0; i < replay.runCount; i++) {
+                for (uint32_t tick = 0; tick < replay.runs[i].length; tick++) {
+                        SimEvents events = sim_step(GD, replay.runs[i].input, dt);
+                        if (events & SIM_EVENT_STARTED) games++;
+                        if (events & SIM_EVENT_PIECE_LOCKED) locks++;
+                        if (events & SIM_EVENT_SAND_CLEARED) clears++;
+                }
+        }
+        double elapsed = nowSeconds() - start;
+
+        printf("replay: %dx%d grid, seed %llu, %ld ticks in %d runs, %s\n", replay.config.width, replay.config.height,
+                (unsigned long long) replay.seed, replay.ticks, replay.runCount,
+                replay.stepper == SIM_STEPPER_SERIAL? "serial sand": "striped sand");
+        printf("ticks: %ld in %.3fs (%.0f ticks/s, %.1fx realtime at %d ticks/s)\n",
+                replay.ticks, elapsed, replay.ticks / elapsed, replay.ticks / elapsed / replay.tickRate, replay.tickRate);
+        printf("games: %ld, pieces locked: %ld, clears: %ld\n", games, locks, clears);
+        printf("score: %u\n", GD->score);
+        printf("grid hash: %016llx\n", (unsigned long long) sim_hashGrid(GD));
+
+        replay_free(&replay);
+        sim_cleanup(GD);
+        free(GD);
+        return 0;
+}